@@ -3,12 +3,25 @@
 #include "style.h"
 #include "header.h"
 #include "average_data.h"
+#include "sample_ring.h"
+#include "sample_store.h"
+#include "sample_export.h"
+#include "sample_kernels.h"
+#include "sample_lod.h"
+#include "chart_tiles.h"
+#include "sample_stats.h"
+#include "sensor_settings.h"
+#include "serial_engine.h"
+#include "text_format.h"
+#include <atomic>
 #include <thread>
 #include <vector>
 #include <string>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
+#include <cstring>
+#include <cmath>
 #include <algorithm>
 
 #ifdef _WIN32
@@ -30,6 +43,7 @@ static lv_obj_t* cb_pres = nullptr;
 static lv_obj_t* screen = nullptr;
 static lv_obj_t* chart = nullptr;
 static lv_obj_t* dropdown_chart_type = nullptr;
+static lv_obj_t* dropdown_chart_range = nullptr;
 static lv_obj_t* ta_last_x = nullptr;
 static lv_obj_t* label_avg_x = nullptr;
 static lv_obj_t* ta_last_min = nullptr;
@@ -37,15 +51,29 @@ static lv_obj_t* label_avg_min = nullptr;
 static lv_obj_t* btn_update_left = nullptr;
 static lv_obj_t* btn_update_right = nullptr;
 static lv_obj_t* btn_update_chart = nullptr;
-
-static std::vector<lv_chart_series_t*> active_series;
-
-struct SensorData {
-    std::tm timestamp{};
-    float   temp = 0;
-    float   cond = 0;
-    float   pres = 0;
-};
+static lv_obj_t* label_chart_range = nullptr;
+static lv_obj_t* btn_export = nullptr;
+static lv_obj_t* lbl_export_btn = nullptr;
+static lv_obj_t* label_export = nullptr;
+static lv_timer_t* export_timer = nullptr;
+
+static SampleExporter exporter;
+
+static ChartTiles chart_tiles;
+static lv_chart_series_t* chart_series[3] = {};
+
+// Visible chart window: chart_columns columns of chart_column_ns from chart_from_ns (wall clock)
+static int64_t chart_from_ns = 0;
+static int64_t chart_column_ns = 1000000000LL;
+static size_t chart_columns = 1;
+static int32_t chart_drag_px = 0;           // Drag not yet turned into whole columns
+static LodSeries chart_view;
+
+// Without a sample store the chart shows the newest raw samples and does not pan or zoom
+static LodSeries chart_fallback;
+static bool chart_fallback_shown = false;
+static bool chart_fallback_tried = false;
+static uint32_t chart_generation = 0;
 
 static const char* simulated_data_text = R"(
 2025-06-24 16:33:19, Temp: 19.559000, Cond: 30.724001, Pres: -0.000002
@@ -65,163 +93,486 @@ static const char* simulated_data_text = R"(
 2025-06-24 16:33:55, Temp: 14.320000, Cond: 25.840000, Pres: -0.000002
 )";
 
-static std::vector<SensorData> parse_lines(std::istream& stream)
+#define LEGACY_TEXT_LOG "/etc/sensor_data.txt"
+
+// Text format used by the simulator sample data and by older versions of the recorder
+static void parse_lines(std::istream& stream, SampleWindow& out)
 {
-    std::vector<SensorData> data;
     std::string line;
     while (std::getline(stream, line)) {
         if (line.empty()) continue;
-        SensorData sd;
+        float temp, cond, pres;
         char date[11], time[9];
         if (sscanf(line.c_str(), "%10s %8s, Temp: %f, Cond: %f, Pres: %f",
-            date, time, &sd.temp, &sd.cond, &sd.pres) == 5) {
-            std::string dt = std::string(date) + " " + std::string(time);
-            std::istringstream ss(dt);
-            ss >> std::get_time(&sd.timestamp, "%Y-%m-%d %H:%M:%S");
-            if (!ss.fail()) data.push_back(sd);
+            date, time, &temp, &cond, &pres) == 5) {
+            std::tm tm{};
+            std::istringstream ss(std::string(date) + " " + std::string(time));
+            ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+            if (ss.fail()) continue;
+            tm.tm_isdst = -1;
+            out.ts.push_back(static_cast<int64_t>(mktime(&tm)) * 1000000000LL);
+            out.temp.push_back(temp);
+            out.cond.push_back(cond);
+            out.pres.push_back(pres);
         }
     }
-    return data;
+}
+
+static void keep_samples(SampleWindow& w, size_t first)
+{
+    w.ts.erase(w.ts.begin(), w.ts.begin() + first);
+    w.temp.erase(w.temp.begin(), w.temp.begin() + first);
+    w.cond.erase(w.cond.begin(), w.cond.begin() + first);
+    w.pres.erase(w.pres.begin(), w.pres.begin() + first);
 }
 
 #if IS_SIMULATOR
-static std::vector<SensorData> load_data()
+static int64_t wall_clock_now_ns()
 {
-    std::istringstream s(simulated_data_text);
-    return parse_lines(s);
+    std::tm now_tm{};
+    std::istringstream ss("2025-06-24 17:00:00");
+    ss >> std::get_time(&now_tm, "%Y-%m-%d %H:%M:%S");
+    now_tm.tm_isdst = -1;
+    return static_cast<int64_t>(mktime(&now_tm)) * 1000000000LL;
 }
 #else
-static std::vector<SensorData> load_data()
+static int64_t wall_clock_now_ns()
 {
-    std::ifstream f("/etc/sensor_data.txt");
-    if (!f) {
-        std::istringstream s(simulated_data_text);
-        return parse_lines(s);
-    }
-    return parse_lines(f);
+    return static_cast<int64_t>(std::time(nullptr)) * 1000000000LL;
 }
 #endif
 
+// Without a sample store: a text log left by an older version, or the built-in sample data
+static void load_text_samples(SampleWindow& out)
+{
+    out.clear();
+#if !IS_SIMULATOR
+    std::ifstream f(LEGACY_TEXT_LOG);
+    if (f) {
+        parse_lines(f, out);
+        return;
+    }
+#endif
+    std::istringstream s(simulated_data_text);
+    parse_lines(s, out);
+}
+
+// Newest `count` samples of the text fallback, oldest first
+static size_t load_text_last(size_t count, SampleWindow& out)
+{
+    load_text_samples(out);
+    if (out.size() > count) keep_samples(out, out.size() - count);
+    return out.size();
+}
+
+// Text fallback samples with a wall-clock stamp >= since_ns
+static size_t load_text_since(int64_t since_ns, SampleWindow& out)
+{
+    load_text_samples(out);
+    size_t first = 0;
+    while (first < out.size() && out.ts[first] < since_ns) ++first;
+    keep_samples(out, first);
+    return out.size();
+}
+
 static int textarea_get_int(lv_obj_t* ta, int fallback)
 {
     const char* txt = lv_textarea_get_text(ta);
     return (txt && txt[0] != '\0') ? std::atoi(txt) : fallback;
 }
 
-static void update_average_by_count(int count)
-{
-    auto data = load_data();
-    int total = std::min(count, static_cast<int>(data.size()));
-    if (total == 0) return;
+// Sums are kept in double precision per channel: a float sum over a long window of
+// pressure values around -0.000002 keeps few significant digits
+struct Averages {
+    ColumnSum sum[3];
 
-    float sumT = 0, sumC = 0, sumP = 0;
-    for (int i = data.size() - total; i < data.size(); ++i) {
-        sumT += data[i].temp;
-        sumC += data[i].cond;
-        sumP += data[i].pres;
+    void add(const RollupStats& s) {
+        for (int c = 0; c < 3; ++c) {
+            sum[c].sum += s.sum[c];
+            sum[c].count += s.count[c];
+        }
     }
+    bool empty() const { return sum[0].count == 0 && sum[1].count == 0 && sum[2].count == 0; }
+};
+
+static void show_averages(lv_obj_t* label, const Averages& avg)
+{
+    if (avg.empty()) return;
 
     char buf[128];
     snprintf(buf, sizeof(buf),
         "Average:\nT=%.2f\nC=%.2f\nP=%.5f",
-        sumT / total, sumC / total, sumP / total);
-    lv_label_set_text(label_avg_x, buf);
+        avg.sum[0].mean(), avg.sum[1].mean(), avg.sum[2].mean());
+    lv_label_set_text(label, buf);
 }
 
-static void update_average_by_minute(int minutes)
+static void add_values(Averages& avg, const float* t, const float* c, const float* p, size_t n)
 {
-    auto data = load_data();
-    if (data.empty()) return;
+    avg.sum[0].add(column_sum(t, n));
+    avg.sum[1].add(column_sum(c, n));
+    avg.sum[2].add(column_sum(p, n));
+}
 
-#if IS_SIMULATOR
-    std::tm now_tm{};
-    std::istringstream ss("2025-06-24 17:00:00");
-    ss >> std::get_time(&now_tm, "%Y-%m-%d %H:%M:%S");
-    time_t now = mktime(&now_tm);
-#else
-    time_t now = std::time(nullptr);
-#endif
+static void add_window(Averages& avg, const SampleWindow& w)
+{
+    add_values(avg, w.temp.data(), w.cond.data(), w.pres.data(), w.size());
+}
 
-    time_t threshold = now - minutes * 60;
-    float sumT = 0, sumC = 0, sumP = 0;
-    int cnt = 0;
-
-    for (auto& d : data) {
-        time_t t = mktime(const_cast<std::tm*>(&d.timestamp));
-        if (t >= threshold) {
-            sumT += d.temp;
-            sumC += d.cond;
-            sumP += d.pres;
-            ++cnt;
-        }
+static bool have_sample_store()
+{
+    return !list_segments(SAMPLE_STORE_DIR).empty();
+}
+
+// The sample store is read in place through the mapped segments, without copying samples
+static void add_log_last(Averages& avg, size_t count)
+{
+    SampleWindow w;
+    if (have_sample_store())
+        store_for_last(SAMPLE_STORE_DIR, count, [&avg](const LogSpan& s) { add_values(avg, s.temp, s.cond, s.pres, s.count); });
+    else if (load_text_last(count, w))
+        add_window(avg, w);
+}
+
+// A time window is answered from the rollup tiers (a few hundred buckets at most);
+// the raw segments are only scanned if there are no rollups
+static void add_log_since(Averages& avg, int64_t since_ns)
+{
+    SampleWindow w;
+    RollupStats stats;
+    if (rollup_stats(SAMPLE_STORE_DIR, since_ns, wall_clock_now_ns() + 1000000000LL, stats) && stats.samples > 0)
+        avg.add(stats);
+    else if (have_sample_store())
+        store_for_since(SAMPLE_STORE_DIR, since_ns, [&avg](const LogSpan& s) { add_values(avg, s.temp, s.cond, s.pres, s.count); });
+    else if (load_text_since(since_ns, w))
+        add_window(avg, w);
+}
+
+// Recent windows come from the recorder's in-memory ring. The log file is only
+// read when the ring does not reach back far enough (e.g. right after boot).
+static void update_average_by_count(int count)
+{
+    if (count <= 0) return;
+    Averages avg;
+
+    SampleWindow w;
+    if (sample_ring().snapshot_last(count, w) == static_cast<size_t>(count))
+        add_window(avg, w);
+    else
+        add_log_last(avg, count);
+
+    show_averages(label_avg_x, avg);
+}
+
+static void update_average_by_minute(int minutes)
+{
+    Averages avg;
+
+    // The ring covers the window if it still holds samples older than its start
+    SampleWindow w;
+    int64_t since_ns = monotonic_ns() - minutes * 60LL * 1000000000LL;
+    size_t n = sample_ring().snapshot_since(since_ns, w);
+    if (n > 0 && n < sample_ring().size()) {
+        add_window(avg, w);
+        show_averages(label_avg_min, avg);
+        return;
     }
-    if (cnt == 0) return;
 
-    char buf[128];
+    add_log_since(avg, wall_clock_now_ns() - minutes * 60LL * 1000000000LL);
+
+    show_averages(label_avg_min, avg);
+}
+
+static void show_stats(lv_obj_t* label, const WindowStats& w, const char* title, const float extra[3])
+{
+    if (w.samples == 0) return;
+
+    char buf[160];
     snprintf(buf, sizeof(buf),
-        "Average:\nT=%.2f\nC=%.2f\nP=%.5f",
-        sumT / cnt, sumC / cnt, sumP / cnt);
-    lv_label_set_text(label_avg_min, buf);
+        "Average:\nT=%.2f\nC=%.2f\nP=%.5f\n%s:\nT=%.2f\nC=%.2f\nP=%.5f",
+        w.mean[0], w.mean[1], w.mean[2], title, extra[0], extra[1], extra[2]);
+    lv_label_set_text(label, buf);
+}
+
+// The recorder keeps both windows up to date (sample_stats.h); a panel follows them
+// continuously once they cover the length typed into it
+static void refresh_stats(lv_timer_t*)
+{
+    static uint32_t shown = 0;
+    uint32_t version = sample_stats().version();
+    if (version == shown) return;
+    shown = version;
+
+    StatsSnapshot s = sample_stats().snapshot();
+    if (s.by_count.complete && s.window_samples == static_cast<uint32_t>(textarea_get_int(ta_last_x, 10)))
+        show_stats(label_avg_x, s.by_count, "EWMA", s.ewma);
+    if (s.by_time.complete && s.window_minutes == static_cast<uint32_t>(textarea_get_int(ta_last_min, 10)))
+        show_stats(label_avg_min, s.by_time, "Std dev", s.by_time.stddev);
+}
+
+static void configure_stats()
+{
+    sample_stats().configure(static_cast<uint32_t>(std::max(textarea_get_int(ta_last_x, 10), 1)),
+        static_cast<uint32_t>(std::max(textarea_get_int(ta_last_min, 10), 1)));
+}
+
+// Chart ranges offered in the range dropdown, in seconds
+static const int64_t CHART_RANGES_S[] = { 10 * 60, 60 * 60, 6 * 60 * 60, 24 * 60 * 60, 7 * 24 * 60 * 60, 30 * 24 * 60 * 60, 365 * 24 * 60 * 60 };
+static const char* CHART_RANGE_OPTIONS = "10 min\n1 hour\n6 hours\n1 day\n1 week\n30 days\n1 year";
+
+// lv_chart stores integers; values are plotted in hundredths so small changes stay visible
+static const float CHART_SCALE = 100.0f;
+
+// Widest zoom: five years, what the hour rollups keep
+static const int64_t CHART_MAX_SPAN_NS = 5 * 365 * 24 * 60 * 60 * 1000000000LL;
+
+// Without a sample store: the newest raw samples, one column each
+static bool load_recent_points(LodSeries& out)
+{
+    const int max_points = 20;
+    SampleWindow w;
+    if (sample_ring().snapshot_last(max_points, w) < max_points &&
+        store_read_last(SAMPLE_STORE_DIR, max_points, w) == 0 &&
+        load_text_last(max_points, w) == 0)
+        return false;
+
+    const std::vector<float>* columns[3] = { &w.temp, &w.cond, &w.pres };
+    for (int c = 0; c < 3; ++c) {
+        out.min[c] = *columns[c];
+        out.max[c] = *columns[c];
+        ColumnStats st = column_stats(columns[c]->data(), w.size());
+        out.lo[c] = st.count ? st.min : 0.0f;
+        out.hi[c] = st.count ? st.max : 0.0f;
+    }
+    out.filled = w.size();
+    return true;
 }
 
-static void rebuild_chart()
+static int32_t chart_value(float v)
 {
-    // Operations that will run in a thread
-    std::thread([] {
-        auto data = load_data();
-        const int max_points = 20;
-        int point_count = std::min(static_cast<int>(data.size()), max_points);
-        if (point_count == 0) return;
+    return std::isnan(v) ? LV_CHART_POINT_NONE : static_cast<int32_t>(lroundf(v * CHART_SCALE));
+}
 
-        std::vector<float> temps, conds, press;
-        for (int i = data.size() - point_count; i < static_cast<int>(data.size()); ++i) {
-            temps.push_back(data[i].temp);
-            conds.push_back(data[i].cond);
-            press.push_back(data[i].pres);
+// Two points per column, its min then its max, written straight into the three series.
+// Unchecked channels are hidden, and the Y axis fits the visible ones.
+static void draw_chart(const LodSeries& d)
+{
+    uint32_t points = static_cast<uint32_t>(std::max<size_t>(d.columns(), 1) * 2);
+    if (lv_chart_get_point_count(chart) != points) lv_chart_set_point_count(chart, points);
+
+    bool show[3] = {
+        lv_obj_has_state(cb_temp, LV_STATE_CHECKED),
+        lv_obj_has_state(cb_cond, LV_STATE_CHECKED),
+        lv_obj_has_state(cb_pres, LV_STATE_CHECKED)
+    };
+
+    float lo = 0.0f, hi = 0.0f;
+    bool any = false;
+    for (int c = 0; c < 3; ++c) {
+        lv_chart_hide_series(chart, chart_series[c], !show[c]);
+        if (!show[c]) continue;
+        int32_t* y = lv_chart_get_y_array(chart, chart_series[c]);
+        for (size_t i = 0; i < d.columns(); ++i) {
+            y[2 * i] = chart_value(d.min[c][i]);
+            y[2 * i + 1] = chart_value(d.max[c][i]);
         }
+        lo = any ? std::min(lo, d.lo[c]) : d.lo[c];
+        hi = any ? std::max(hi, d.hi[c]) : d.hi[c];
+        any = true;
+    }
+
+    int32_t y_min = static_cast<int32_t>(floorf(lo * CHART_SCALE));
+    int32_t y_max = static_cast<int32_t>(ceilf(hi * CHART_SCALE));
+    if (y_max <= y_min) y_max = y_min + 1;
+    lv_chart_set_range(chart, LV_CHART_AXIS_PRIMARY_Y, y_min, y_max);
+    lv_chart_refresh(chart);
+}
 
-        // GUI operations are dispatched to the main thread
-        lv_async_call([](void* param) {
-            auto* d = static_cast<std::tuple<std::vector<float>, std::vector<float>, std::vector<float>>*>(param);
-            const auto& temps = std::get<0>(*d);
-            const auto& conds = std::get<1>(*d);
-            const auto& press = std::get<2>(*d);
-
-            for (auto* s : active_series) lv_chart_remove_series(chart, s);
-            active_series.clear();
-
-            lv_chart_set_point_count(chart, temps.size());
-
-            uint16_t sel = lv_dropdown_get_selected(dropdown_chart_type);
-            lv_chart_set_type(chart,
-                sel == 0 ? LV_CHART_TYPE_LINE :
-                sel == 1 ? LV_CHART_TYPE_BAR :
-                LV_CHART_TYPE_SCATTER);
-
-            bool showT = lv_obj_has_state(cb_temp, LV_STATE_CHECKED);
-            bool showC = lv_obj_has_state(cb_cond, LV_STATE_CHECKED);
-            bool showP = lv_obj_has_state(cb_pres, LV_STATE_CHECKED);
-
-            lv_chart_series_t* sT = nullptr;
-            lv_chart_series_t* sC = nullptr;
-            lv_chart_series_t* sP = nullptr;
-
-            if (showT) { sT = lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_RED), LV_CHART_AXIS_PRIMARY_Y); active_series.push_back(sT); }
-            if (showC) { sC = lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_BLUE), LV_CHART_AXIS_PRIMARY_Y); active_series.push_back(sC); }
-            if (showP) { sP = lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_GREEN), LV_CHART_AXIS_PRIMARY_Y); active_series.push_back(sP); }
-
-            for (size_t i = 0; i < temps.size(); ++i) {
-                if (sT) lv_chart_set_next_value(chart, sT, temps[i]);
-                if (sC) lv_chart_set_next_value(chart, sC, conds[i]);
-                if (sP) lv_chart_set_next_value(chart, sP, press[i]);
-            }
-
-            lv_chart_refresh(chart);
-            delete d;
-            }, new std::tuple<std::vector<float>, std::vector<float>, std::vector<float>>(temps, conds, press));
+static void show_chart_range()
+{
+    TimestampFormatter fmt;
+    char from[TEXT_TIME_LEN], to[TEXT_TIME_LEN];
+    fmt.format(chart_from_ns, from);
+    fmt.format(chart_from_ns + chart_column_ns * static_cast<int64_t>(chart_columns), to);
+    lv_label_set_text_fmt(label_chart_range, "%.16s - %.16s", from, to);     // Down to the minute
+}
+
+struct ChartFallback {
+    uint32_t generation;
+    LodSeries lod;
+};
+
+// Handed from the worker thread to poll_chart(), which runs on the LVGL thread
+static std::atomic<ChartFallback*> chart_fallback_ready{ nullptr };
+
+static void load_chart_fallback()
+{
+    ChartFallback* f = new ChartFallback{ chart_generation, LodSeries() };
+    std::thread([f] {
+        if (!load_recent_points(f->lod)) {
+            delete f;
+            return;
+        }
+        delete chart_fallback_ready.exchange(f);
         }).detach();
 }
 
+// Redraws the visible window from the tile cache. Tiles that are not loaded yet are drawn
+// empty and requested; poll_chart() redraws as they arrive, so panning never waits.
+static void render_chart()
+{
+    if (chart_fallback_shown) {
+        draw_chart(chart_fallback);
+        return;
+    }
+
+    size_t loaded = chart_tiles.view(chart_from_ns, chart_column_ns, chart_columns, wall_clock_now_ns(), chart_view);
+    draw_chart(chart_view);
+    show_chart_range();
+
+    // Nothing recorded at all: the ring, a legacy text log or the built-in samples
+    if (loaded == chart_columns && chart_view.filled == 0 && !chart_fallback_tried) {
+        chart_fallback_tried = true;
+        load_chart_fallback();
+    }
+}
+
+// The newest whole column ends at or after "now"; the view never starts past that
+static int64_t latest_chart_from()
+{
+    int64_t end_ns = wall_clock_now_ns() + 1000000000LL;
+    return ((end_ns + chart_column_ns - 1) / chart_column_ns - static_cast<int64_t>(chart_columns)) * chart_column_ns;
+}
+
+// The newest data over the range in the dropdown, one column per pixel
+static void reset_chart_view()
+{
+    lv_obj_update_layout(chart);
+    chart_columns = static_cast<size_t>(std::max<int32_t>(lv_obj_get_content_width(chart), 1));
+    int64_t range_ns = CHART_RANGES_S[lv_dropdown_get_selected(dropdown_chart_range)] * 1000000000LL;
+    chart_column_ns = std::max<int64_t>(range_ns / static_cast<int64_t>(chart_columns), CHART_MIN_COLUMN_NS);
+    chart_from_ns = latest_chart_from();
+    chart_drag_px = 0;
+
+    ++chart_generation;
+    chart_fallback_shown = false;
+    chart_fallback_tried = false;
+    chart_tiles.clear();
+    render_chart();
+}
+
+// Dragging right moves back in time, by whole columns
+static void pan_chart(int32_t dx)
+{
+    if (chart_fallback_shown) return;
+    int32_t width = std::max<int32_t>(lv_obj_get_content_width(chart), 1);
+    chart_drag_px += dx * static_cast<int32_t>(chart_columns);
+    int64_t shift = chart_drag_px / width;
+    chart_drag_px %= width;
+    if (shift == 0) return;
+
+    int64_t from_ns = std::min(chart_from_ns - shift * chart_column_ns, latest_chart_from());
+    if (from_ns == chart_from_ns) return;
+    chart_from_ns = from_ns;
+    render_chart();
+}
+
+// One step halves or doubles the column width around the middle of the view. The
+// coarsest step still spans less than the hour rollups keep.
+static void zoom_chart(bool in)
+{
+    if (chart_fallback_shown) return;
+    int64_t column_ns = in ? chart_column_ns / 2 : chart_column_ns * 2;
+    if (column_ns < CHART_MIN_COLUMN_NS || column_ns * static_cast<int64_t>(chart_columns) > CHART_MAX_SPAN_NS) return;
+
+    int64_t center_ns = chart_from_ns + chart_column_ns * static_cast<int64_t>(chart_columns) / 2;
+    chart_column_ns = column_ns;
+    chart_from_ns = (center_ns - column_ns * static_cast<int64_t>(chart_columns) / 2) / column_ns * column_ns;
+    chart_from_ns = std::min(chart_from_ns, latest_chart_from());
+    render_chart();
+}
+
+// LVGL timer: picks up what the background threads finished. A reset since the
+// fallback was requested wins over it.
+static void poll_chart(lv_timer_t*)
+{
+    ChartFallback* f = chart_fallback_ready.exchange(nullptr);
+    if (f && f->generation == chart_generation) {
+        chart_fallback = std::move(f->lod);
+        chart_fallback_shown = true;
+        draw_chart(chart_fallback);
+        lv_label_set_text(label_chart_range, "Newest samples");
+    }
+    delete f;
+
+    if (chart_tiles.take_ready() && !chart_fallback_shown) render_chart();
+}
+
+static void apply_chart_type()
+{
+    uint16_t sel = lv_dropdown_get_selected(dropdown_chart_type);
+    lv_chart_set_type(chart,
+        sel == 0 ? LV_CHART_TYPE_LINE :
+        sel == 1 ? LV_CHART_TYPE_BAR :
+        LV_CHART_TYPE_SCATTER);
+    render_chart();
+}
+
+
+static void update_export_status(lv_timer_t*)
+{
+    ExportProgress p = exporter.progress();
+    char buf[96];
+    switch (p.state) {
+    case ExportState::Running:
+        snprintf(buf, sizeof(buf), "Exporting %d%%\n%llu rows", p.percent, static_cast<unsigned long long>(p.samples));
+        break;
+    case ExportState::Done:
+        snprintf(buf, sizeof(buf), "Saved %llu rows", static_cast<unsigned long long>(p.samples));
+        break;
+    case ExportState::Cancelled:
+        snprintf(buf, sizeof(buf), "Export cancelled");
+        break;
+    default:
+        snprintf(buf, sizeof(buf), "Export failed\n%s", p.error ? strerror(p.error) : "");
+        break;
+    }
+    lv_label_set_text(label_export, buf);
+
+    if (p.state != ExportState::Running && export_timer) {
+        lv_label_set_text(lbl_export_btn, "Export");
+        lv_timer_del(export_timer);
+        export_timer = nullptr;
+    }
+}
+
+// Exports the "Last X Minutes" window (0 = everything recorded) of the checked channels
+// to the export directory. The file is written in the background; pressing again cancels.
+static void toggle_export()
+{
+    if (exporter.running()) {
+        exporter.cancel();
+        return;
+    }
+
+    ExportRequest r;
+    r.format = (export_format == "JSONL") ? ExportFormat::JsonLines : ExportFormat::Csv;
+    r.path = export_file_name(export_dir, r.format);
+    int minutes = textarea_get_int(ta_last_min, 10);
+    if (minutes > 0) r.from_ns = wall_clock_now_ns() - minutes * 60LL * 1000000000LL;
+    r.channels = 0;
+    if (lv_obj_has_state(cb_temp, LV_STATE_CHECKED)) r.channels |= EXPORT_TEMPERATURE;
+    if (lv_obj_has_state(cb_cond, LV_STATE_CHECKED)) r.channels |= EXPORT_CONDUCTIVITY;
+    if (lv_obj_has_state(cb_pres, LV_STATE_CHECKED)) r.channels |= EXPORT_PRESSURE;
+    if (r.channels == 0) r.channels = EXPORT_ALL;
+
+    if (!exporter.start(r)) {
+        lv_label_set_text(label_export, "Export failed");
+        return;
+    }
+    lv_label_set_text(lbl_export_btn, "Cancel");
+    if (!export_timer) export_timer = lv_timer_create(update_export_status, 250, nullptr);
+    update_export_status(nullptr);
+}
 
 static void show_keyboard(lv_obj_t* target)
 {
@@ -283,6 +634,7 @@ void create_average_data_screen()
     lv_obj_align_to(btn_update_left, ta_last_x, LV_ALIGN_OUT_BOTTOM_MID, 0, 10);
     lv_obj_add_event_cb(btn_update_left, [](lv_event_t*) {
         hide_keyboard();
+        configure_stats();
         update_average_by_count(textarea_get_int(ta_last_x, 10));
         }, LV_EVENT_CLICKED, nullptr);
 
@@ -322,6 +674,7 @@ void create_average_data_screen()
     lv_obj_align_to(btn_update_right, ta_last_min, LV_ALIGN_OUT_BOTTOM_MID, 0, 10);
     lv_obj_add_event_cb(btn_update_right, [](lv_event_t*) {
         hide_keyboard();
+        configure_stats();
         update_average_by_minute(textarea_get_int(ta_last_min, 10));
         }, LV_EVENT_CLICKED, nullptr);
 
@@ -346,36 +699,89 @@ void create_average_data_screen()
     dropdown_chart_type = lv_dropdown_create(center_panel);
     lv_dropdown_set_options(dropdown_chart_type, "Line\nBar\nScatter");
     lv_obj_set_width(dropdown_chart_type, 150);
-    lv_obj_align(dropdown_chart_type, LV_ALIGN_TOP_MID, 0, 0);
-    lv_obj_add_event_cb(dropdown_chart_type, [](lv_event_t*) { rebuild_chart(); }, LV_EVENT_VALUE_CHANGED, nullptr);
+    lv_obj_align(dropdown_chart_type, LV_ALIGN_TOP_MID, -80, 0);
+    lv_obj_add_event_cb(dropdown_chart_type, [](lv_event_t*) { apply_chart_type(); }, LV_EVENT_VALUE_CHANGED, nullptr);
+
+    dropdown_chart_range = lv_dropdown_create(center_panel);
+    lv_dropdown_set_options(dropdown_chart_range, CHART_RANGE_OPTIONS);
+    lv_obj_set_width(dropdown_chart_range, 150);
+    lv_obj_align(dropdown_chart_range, LV_ALIGN_TOP_MID, 80, 0);
+    lv_obj_add_event_cb(dropdown_chart_range, [](lv_event_t*) { reset_chart_view(); }, LV_EVENT_VALUE_CHANGED, nullptr);
 
     cb_temp = lv_checkbox_create(center_panel);
     lv_checkbox_set_text(cb_temp, "Temperature");
     lv_obj_add_style(cb_temp, &style_label_white, 0);
 
     lv_obj_align(cb_temp, LV_ALIGN_TOP_MID, -110, 55);
-    lv_obj_add_event_cb(cb_temp, [](lv_event_t*) { rebuild_chart(); }, LV_EVENT_VALUE_CHANGED, nullptr);
+    lv_obj_add_event_cb(cb_temp, [](lv_event_t*) { render_chart(); }, LV_EVENT_VALUE_CHANGED, nullptr);
 
     cb_cond = lv_checkbox_create(center_panel);
     lv_checkbox_set_text(cb_cond, "Conductivity");
     lv_obj_add_style(cb_cond, &style_label_white, 0);
 
     lv_obj_align(cb_cond, LV_ALIGN_TOP_MID, 0, 55);
-    lv_obj_add_event_cb(cb_cond, [](lv_event_t*) { rebuild_chart(); }, LV_EVENT_VALUE_CHANGED, nullptr);
+    lv_obj_add_event_cb(cb_cond, [](lv_event_t*) { render_chart(); }, LV_EVENT_VALUE_CHANGED, nullptr);
 
     cb_pres = lv_checkbox_create(center_panel);
     lv_checkbox_set_text(cb_pres, "Pressure");
     lv_obj_add_style(cb_pres, &style_label_white, 0);
 
     lv_obj_align(cb_pres, LV_ALIGN_TOP_MID, 110, 55);
-    lv_obj_add_event_cb(cb_pres, [](lv_event_t*) { rebuild_chart(); }, LV_EVENT_VALUE_CHANGED, nullptr);
+    lv_obj_add_event_cb(cb_pres, [](lv_event_t*) { render_chart(); }, LV_EVENT_VALUE_CHANGED, nullptr);
 
     chart = lv_chart_create(center_panel);
     lv_obj_set_size(chart, 400, 140);
     lv_obj_align(chart, LV_ALIGN_CENTER, 0, 40);
     lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
-
-    rebuild_chart();
+    const lv_palette_t colors[3] = { LV_PALETTE_RED, LV_PALETTE_BLUE, LV_PALETTE_GREEN };
+    for (int c = 0; c < 3; ++c)
+        chart_series[c] = lv_chart_add_series(chart, lv_palette_main(colors[c]), LV_CHART_AXIS_PRIMARY_Y);
+
+    // Drags pan the chart instead of scrolling the panel
+    lv_obj_remove_flag(chart, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_remove_flag(chart, LV_OBJ_FLAG_SCROLL_CHAIN);
+    lv_obj_add_event_cb(chart, [](lv_event_t* e) {
+        lv_event_code_t code = lv_event_get_code(e);
+        if (code == LV_EVENT_PRESSED) {
+            chart_drag_px = 0;
+        }
+        else if (code == LV_EVENT_PRESSING) {
+            lv_point_t v;
+            lv_indev_get_vect(lv_indev_active(), &v);
+            pan_chart(v.x);
+        }
+        }, LV_EVENT_ALL, nullptr);
+
+    // The touch panel reports a single point, so zoom is on buttons rather than a pinch
+    lv_obj_t* btn_zoom_in = lv_btn_create(center_panel);
+    lv_obj_set_size(btn_zoom_in, 32, 32);
+    lv_obj_add_style(btn_zoom_in, &style_button, 0);
+    lv_obj_align_to(btn_zoom_in, chart, LV_ALIGN_TOP_RIGHT, -4, 4);
+    lv_obj_add_event_cb(btn_zoom_in, [](lv_event_t*) { zoom_chart(true); }, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t* lbl_zoom_in = lv_label_create(btn_zoom_in);
+    lv_label_set_text(lbl_zoom_in, LV_SYMBOL_PLUS);
+    lv_obj_center(lbl_zoom_in);
+    lv_obj_add_style(lbl_zoom_in, &style_label_white, 0);
+
+    lv_obj_t* btn_zoom_out = lv_btn_create(center_panel);
+    lv_obj_set_size(btn_zoom_out, 32, 32);
+    lv_obj_add_style(btn_zoom_out, &style_button, 0);
+    lv_obj_align_to(btn_zoom_out, btn_zoom_in, LV_ALIGN_OUT_LEFT_MID, -4, 0);
+    lv_obj_add_event_cb(btn_zoom_out, [](lv_event_t*) { zoom_chart(false); }, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t* lbl_zoom_out = lv_label_create(btn_zoom_out);
+    lv_label_set_text(lbl_zoom_out, LV_SYMBOL_MINUS);
+    lv_obj_center(lbl_zoom_out);
+    lv_obj_add_style(lbl_zoom_out, &style_label_white, 0);
+
+    label_chart_range = lv_label_create(center_panel);
+    lv_label_set_text(label_chart_range, "");
+    lv_obj_add_style(label_chart_range, &style_label_white, 0);
+    lv_obj_align_to(label_chart_range, chart, LV_ALIGN_OUT_BOTTOM_MID, 0, 4);
+
+    reset_chart_view();
+    lv_timer_create(poll_chart, LV_DEF_REFR_PERIOD, nullptr);
 
     // -------- Chart “Update” --------
     btn_update_chart = lv_btn_create(screen);
@@ -384,7 +790,7 @@ void create_average_data_screen()
     lv_obj_set_style_bg_color(btn_update_chart, lv_color_hex(0x2ecc71), 0);
     lv_obj_set_style_bg_opa(btn_update_chart, LV_OPA_COVER, 0);
     lv_obj_set_style_radius(btn_update_chart, 6, 0);
-    lv_obj_add_event_cb(btn_update_chart, [](lv_event_t*) { hide_keyboard(); rebuild_chart(); }, LV_EVENT_CLICKED, nullptr);
+    lv_obj_add_event_cb(btn_update_chart, [](lv_event_t*) { hide_keyboard(); reset_chart_view(); }, LV_EVENT_CLICKED, nullptr);
 
     lv_obj_t* lbl_chart_btn = lv_label_create(btn_update_chart);
     lv_label_set_text(lbl_chart_btn, "Update");
@@ -402,9 +808,28 @@ void create_average_data_screen()
     lv_obj_center(lbl_back);
     lv_obj_add_style(lbl_back, &style_label_white, 0);
 
+    btn_export = lv_btn_create(screen);
+    lv_obj_set_size(btn_export, 100, 40);
+    lv_obj_add_style(btn_export, &style_button, 0);
+    lv_obj_align(btn_export, LV_ALIGN_BOTTOM_RIGHT, -10, -10);
+    lv_obj_add_event_cb(btn_export, [](lv_event_t*) { hide_keyboard(); toggle_export(); }, LV_EVENT_CLICKED, nullptr);
+
+    lbl_export_btn = lv_label_create(btn_export);
+    lv_label_set_text(lbl_export_btn, "Export");
+    lv_obj_center(lbl_export_btn);
+    lv_obj_add_style(lbl_export_btn, &style_label_white, 0);
+
+    label_export = lv_label_create(screen);
+    lv_label_set_text(label_export, "");
+    lv_obj_add_style(label_export, &style_label_white, 0);
+    lv_obj_align(label_export, LV_ALIGN_BOTTOM_RIGHT, -120, -12);      // Grows to the left, clear of the button
+
     lv_obj_add_event_cb(screen, [](lv_event_t* e) {
         if (lv_event_get_code(e) == LV_EVENT_CLICKED) hide_keyboard();
         }, LV_EVENT_CLICKED, nullptr);
 
+    configure_stats();
+    lv_timer_create(refresh_stats, 500, nullptr);
+
     ScreenManager::get_instance().register_screen(screen, [] {/* actions when the screen is shown again */});
 }
@@ -0,0 +1,115 @@
+﻿#include "text_format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+// Formats the same rows as the old text log, once through iostream (strftime and
+// std::fixed << std::setprecision(6), as sensor_recorder.cpp did) and once through
+// text_format.h into a reusable buffer written once per batch. Both go to /dev/null.
+// Also checks that every format_float() output reads back as the same float.
+//
+//     bench_format [rows]
+
+#define BENCH_ROWS   2000000
+#define BENCH_BATCH  (256 * 1024)
+
+struct Row {
+    int64_t ts_ns;
+    float v[3];
+};
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double run_iostream(const std::vector<Row>& rows) {
+    std::ofstream out("/dev/null");
+    auto start = std::chrono::steady_clock::now();
+    for (const Row& r : rows) {
+        char timestamp[20];
+        std::time_t t = static_cast<std::time_t>(r.ts_ns / 1000000000);
+        std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
+        out << std::fixed << std::setprecision(6);
+        out << timestamp;
+        out << ", Temp: " << r.v[0];
+        out << ", Cond: " << r.v[1];
+        out << ", Pres: " << r.v[2];
+        out << "\n";
+    }
+    out.flush();
+    return elapsed_ms(start);
+}
+
+static double run_text_format(const std::vector<Row>& rows) {
+    static const char* labels[3] = { ", Temp: ", ", Cond: ", ", Pres: " };
+    FILE* out = fopen("/dev/null", "wb");
+    std::vector<char> buf(BENCH_BATCH);
+    size_t used = 0;
+    TimestampFormatter time;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Row& r : rows) {
+        if (used + 128 > buf.size()) {
+            fwrite(buf.data(), 1, used, out);
+            used = 0;
+        }
+        char* p = buf.data() + used;
+        p += time.format(r.ts_ns, p);
+        for (int c = 0; c < 3; ++c) {
+            memcpy(p, labels[c], 8);
+            p += 8;
+            p += format_float(r.v[c], p);
+        }
+        *p++ = '\n';
+        used = static_cast<size_t>(p - buf.data());
+    }
+    fwrite(buf.data(), 1, used, out);
+    fclose(out);
+    return elapsed_ms(start);
+}
+
+static size_t round_trip_failures(const std::vector<Row>& rows) {
+    size_t failures = 0;
+    for (const Row& r : rows) {
+        for (float v : r.v) {
+            char text[TEXT_FLOAT_MAX + 1];
+            text[format_float(v, text)] = '\0';
+            if (strtof(text, nullptr) != v) ++failures;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : BENCH_ROWS;
+
+    // A day at 20 Hz or so: temperature, conductivity and a pressure near zero
+    std::vector<Row> rows(count);
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    int64_t ts = 1750000000LL * 1000000000LL;
+    for (Row& r : rows) {
+        r.ts_ns = ts;
+        r.v[0] = 19.5f + 0.1f * noise(rng);
+        r.v[1] = 30.8f + 0.1f * noise(rng);
+        r.v[2] = -0.000002f + 0.00001f * noise(rng);
+        ts += 50000000;
+    }
+
+    double iostream_ms = run_iostream(rows);
+    double text_ms = run_text_format(rows);
+    size_t failures = round_trip_failures(rows);
+
+    printf("%zu rows\n", count);
+    printf("  iostream     %8.1f ms  %6.0f ns/row\n", iostream_ms, iostream_ms * 1e6 / count);
+    printf("  text_format  %8.1f ms  %6.0f ns/row  %.1fx\n", text_ms, text_ms * 1e6 / count, iostream_ms / text_ms);
+    printf("  round trip failures: %zu\n", failures);
+    return failures ? 1 : 0;
+}
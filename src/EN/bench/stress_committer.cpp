@@ -0,0 +1,61 @@
+﻿#include "sample_committer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+
+// Regression check for the committer's wakeup: a burst fills the queue while the writer
+// is busy committing, so pushes cross the batch threshold during the drain. After an
+// idle period, samples arrive one per 100 us (the simulator's 10 kHz) and none may be
+// dropped. Commits are on batch size only and every block write is O_DSYNC, which
+// keeps the writer busy long enough for the race to show.
+//
+//     stress_committer [store dir] [trials]
+
+#define STRESS_BATCH        32
+#define STRESS_BURST_MS     20
+#define STRESS_IDLE_MS      200
+#define STRESS_SLOW_PUSHES  5000
+#define STRESS_SLOW_US      100
+
+int main(int argc, char** argv) {
+    SampleStoreConfig config;
+    config.dir = argc > 1 ? argv[1] : "/tmp/stress_committer";
+    config.durability = LogDurability::Dsync;
+    int trials = argc > 2 ? atoi(argv[2]) : 5;
+
+    using clock = std::chrono::steady_clock;
+    int64_t ts_ns = 1700000000LL * 1000000000LL;
+    sensor_data_t data = { 20.0f, 1.0f, 0.001f };
+    int failed = 0;
+
+    for (int t = 1; t <= trials; ++t) {
+        SampleCommitter committer;
+        if (!committer.start(config, STRESS_BATCH, 0)) return 1;
+
+        uint64_t burst = 0;
+        auto end = clock::now() + std::chrono::milliseconds(STRESS_BURST_MS);
+        while (clock::now() < end) {
+            committer.push(ts_ns += 1000, data);
+            ++burst;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(STRESS_IDLE_MS));
+
+        int dropped = 0;
+        auto next = clock::now();
+        for (int i = 0; i < STRESS_SLOW_PUSHES; ++i) {
+            next += std::chrono::microseconds(STRESS_SLOW_US);
+            std::this_thread::sleep_until(next);
+            if (!committer.push(ts_ns += STRESS_SLOW_US * 1000, data)) ++dropped;
+        }
+        committer.stop();
+
+        SampleCommitter::Stats s = committer.stats();
+        printf("trial %d: burst %llu pushes, slow phase dropped %d of %d, %llu batches\n", t,
+            (unsigned long long)burst, dropped, STRESS_SLOW_PUSHES, (unsigned long long)s.batches);
+        if (dropped) ++failed;
+    }
+    printf("%s\n", failed ? "FAILED" : "ok");
+    return failed ? 1 : 0;
+}
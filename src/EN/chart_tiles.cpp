@@ -0,0 +1,184 @@
+﻿#include "chart_tiles.h"
+#include "sample_kernels.h"
+
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+static int64_t steady_ms()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Rounds towards minus infinity, so tiles before 1970 line up like the others
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+ChartTiles::~ChartTiles()
+{
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (loader.joinable()) loader.join();
+}
+
+void ChartTiles::clear()
+{
+    std::lock_guard<std::mutex> l(lock);
+    tiles.clear();
+    queue.clear();
+    shown.clear();
+    ++generation;
+}
+
+// Missing, or reaching past "now" and old enough to be loaded again
+bool ChartTiles::wanted(const Key& k, int64_t now_ms) const
+{
+    if (busy && loading == k) return false;
+    if (std::find(queue.begin(), queue.end(), k) != queue.end()) return false;
+    auto it = tiles.find(k);
+    return it == tiles.end() || (it->second.open && now_ms - it->second.loaded_ms >= CHART_TILE_REFRESH_MS);
+}
+
+void ChartTiles::want(const Key& k, int64_t now_ms)
+{
+    if (wanted(k, now_ms)) queue.push_back(k);
+}
+
+// Least recently viewed first; the tiles on screen always stay
+void ChartTiles::evict()
+{
+    while (tiles.size() > CHART_TILE_CACHE) {
+        auto victim = tiles.end();
+        for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+            if (std::find(shown.begin(), shown.end(), it->first) != shown.end()) continue;
+            if (victim == tiles.end() || it->second.used < victim->second.used) victim = it;
+        }
+        if (victim == tiles.end()) return;
+        tiles.erase(victim);
+    }
+}
+
+size_t ChartTiles::view(int64_t from_ns, int64_t column_ns, size_t columns, int64_t now, LodSeries& out)
+{
+    column_ns = std::max<int64_t>(column_ns, 1);
+    columns = std::max<size_t>(columns, 1);
+    int64_t first_col = floor_div(from_ns, column_ns);
+    int64_t end_col = first_col + static_cast<int64_t>(columns);
+
+    out.from_ns = first_col * column_ns;
+    out.column_ns = column_ns;
+    for (int c = 0; c < 3; ++c) {
+        out.min[c].assign(columns, NAN);
+        out.max[c].assign(columns, NAN);
+        out.lo[c] = out.hi[c] = 0.0f;
+    }
+    out.filled = 0;
+    out.source = -1;
+
+    int64_t now_ms = steady_ms();
+    size_t loaded = 0;
+    bool any_source = false;
+    std::unique_lock<std::mutex> l(lock);
+    if (!loader.joinable()) loader = std::thread([this] { run(); });
+    now_ns = now;
+    ++views;
+    queue.clear();
+    shown.clear();
+
+    int64_t first_tile = floor_div(first_col, CHART_TILE_COLUMNS);
+    int64_t last_tile = floor_div(end_col - 1, CHART_TILE_COLUMNS);
+    for (int64_t index = first_tile; index <= last_tile; ++index) {
+        Key k = { column_ns, index };
+        shown.push_back(k);
+        want(k, now_ms);
+
+        auto it = tiles.find(k);
+        if (it == tiles.end()) continue;
+        Tile& t = it->second;
+        t.used = views;
+
+        // Overlap of the tile and the view, in absolute columns
+        int64_t tile_col = index * CHART_TILE_COLUMNS;
+        int64_t a = std::max(tile_col, first_col);
+        int64_t b = std::min(tile_col + CHART_TILE_COLUMNS, end_col);
+        for (int c = 0; c < 3; ++c) {
+            std::copy(t.lod.min[c].begin() + (a - tile_col), t.lod.min[c].begin() + (b - tile_col), out.min[c].begin() + (a - first_col));
+            std::copy(t.lod.max[c].begin() + (a - tile_col), t.lod.max[c].begin() + (b - tile_col), out.max[c].begin() + (a - first_col));
+        }
+        loaded += static_cast<size_t>(b - a);
+        if (t.lod.filled) {
+            out.source = any_source ? std::min(out.source, t.lod.source) : t.lod.source;
+            any_source = true;
+        }
+    }
+
+    // Prefetch: the next tiles to pan into, then the same view one zoom step out and in
+    for (int64_t d = 1; d <= CHART_TILE_PREFETCH; ++d) {
+        want({ column_ns, first_tile - d }, now_ms);
+        want({ column_ns, last_tile + d }, now_ms);
+    }
+    const int64_t levels[2] = { column_ns * 2, column_ns / 2 };
+    for (int64_t level : levels) {
+        if (level < CHART_MIN_COLUMN_NS) continue;
+        int64_t tile_ns = level * CHART_TILE_COLUMNS;
+        for (int64_t index = floor_div(out.from_ns, tile_ns); index <= floor_div(end_col * column_ns - 1, tile_ns); ++index)
+            want({ level, index }, now_ms);
+    }
+    bool start = !queue.empty();
+    l.unlock();
+    if (start) wake.notify_one();
+
+    for (int c = 0; c < 3; ++c) {
+        ColumnStats lo = column_stats(out.min[c].data(), columns);
+        ColumnStats hi = column_stats(out.max[c].data(), columns);
+        if (lo.count) {
+            out.lo[c] = lo.min;
+            out.hi[c] = hi.max;
+        }
+    }
+    for (size_t i = 0; i < columns; ++i)
+        if (!isnan(out.min[0][i]) || !isnan(out.min[1][i]) || !isnan(out.min[2][i])) ++out.filled;
+    return loaded;
+}
+
+void ChartTiles::run()
+{
+    std::unique_lock<std::mutex> l(lock);
+    for (;;) {
+        wake.wait(l, [this] { return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        Key k = queue.front();
+        queue.pop_front();
+        loading = k;
+        busy = true;
+        uint64_t gen = generation;
+        int64_t tile_ns = k.column_ns * CHART_TILE_COLUMNS;
+        int64_t from_ns = k.index * tile_ns;
+        bool open = from_ns + tile_ns > now_ns;
+        l.unlock();
+
+        LodSeries lod;
+        lod_query(dir, from_ns, from_ns + tile_ns, CHART_TILE_COLUMNS, lod);
+
+        l.lock();
+        busy = false;
+        if (gen != generation) continue;
+        Tile& t = tiles[k];
+        t.lod = std::move(lod);
+        t.loaded_ms = steady_ms();
+        t.open = open;
+        t.used = views;
+        evict();
+
+        if (std::find(shown.begin(), shown.end(), k) != shown.end())
+            ready.store(true);
+    }
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "sample_lod.h"
+#include "sample_store.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tile cache behind the zoomable chart on the Average Data screen.
+//
+// A zoom level is a column width. Each level is cut into tiles of CHART_TILE_COLUMNS
+// columns, aligned on multiples of the tile length so the same tile serves every view
+// that overlaps it. view() only copies loaded columns and never waits: missing tiles
+// are queued for a loader thread (lod_query), visible ones first, then the tiles on
+// either side and the levels one zoom step in and out. Panning therefore redraws from
+// memory, and take_ready() tells the UI thread when a tile the last view needed arrives.
+
+#define CHART_TILE_COLUMNS     128
+#define CHART_TILE_CACHE       64          // Tiles kept, about 200 KB
+#define CHART_TILE_PREFETCH    2           // Tiles loaded ahead on each side
+#define CHART_TILE_REFRESH_MS  5000        // Age after which a tile reaching past "now" is loaded again
+#define CHART_MIN_COLUMN_NS    10000000LL  // Deepest zoom, 10 ms per column
+
+class ChartTiles {
+public:
+    explicit ChartTiles(const std::string& store_dir = SAMPLE_STORE_DIR) : dir(store_dir) {}
+    ~ChartTiles();
+
+    // True once after a tile of the last view() has loaded; polled from an LVGL timer
+    bool take_ready() { return ready.exchange(false); }
+
+    // Drops every tile, e.g. when the chart is reset to the newest data
+    void clear();
+
+    // Fills `out` with `columns` columns of `column_ns` starting at from_ns (rounded down to
+    // a column), NaN where the tile is not loaded yet or has no data. `now_ns` is the wall
+    // clock; tiles that reach past it are refreshed. Returns the number of columns whose tile is loaded.
+    size_t view(int64_t from_ns, int64_t column_ns, size_t columns, int64_t now_ns, LodSeries& out);
+
+private:
+    struct Key {
+        int64_t column_ns;
+        int64_t index;      // Tile start / (CHART_TILE_COLUMNS * column_ns)
+
+        bool operator<(const Key& o) const { return column_ns != o.column_ns ? column_ns < o.column_ns : index < o.index; }
+        bool operator==(const Key& o) const { return column_ns == o.column_ns && index == o.index; }
+    };
+
+    struct Tile {
+        LodSeries lod;
+        uint64_t used = 0;          // view() call that last touched it
+        int64_t loaded_ms = 0;      // Steady clock
+        bool open = false;          // Reached past "now" when it was loaded
+    };
+
+    bool wanted(const Key& k, int64_t now_ms) const;
+    void want(const Key& k, int64_t now_ms);
+    void evict();
+    void run();
+
+    std::string dir;
+    std::atomic<bool> ready{ false };
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::map<Key, Tile> tiles;
+    std::deque<Key> queue;              // Rebuilt by every view(), most urgent first
+    std::vector<Key> shown;             // Tiles of the last view
+    Key loading = { 0, 0 };
+    bool busy = false;
+    uint64_t views = 0;
+    uint64_t generation = 0;            // Bumped by clear(); older results are dropped
+    int64_t now_ns = 0;
+    bool stopping = false;
+    std::thread loader;
+};
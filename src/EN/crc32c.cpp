@@ -0,0 +1,97 @@
+﻿#include "crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__GNUC__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define CRC32C_ARM 1
+#endif
+
+namespace {
+    struct Crc32cTable {
+        uint32_t entries[256];
+
+        constexpr Crc32cTable() : entries() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+                entries[i] = crc;
+            }
+        }
+    };
+
+    constexpr Crc32cTable crc_table;
+
+    uint32_t crc32c_table(uint32_t crc, const uint8_t* p, size_t len) {
+        for (size_t i = 0; i < len; ++i)
+            crc = (crc >> 8) ^ crc_table.entries[(crc ^ p[i]) & 0xFF];
+        return crc;
+    }
+
+#if defined(CRC32C_X86)
+    __attribute__((target("sse4.2")))
+    uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, size_t len) {
+        uint64_t c = crc;
+        for (; len >= 8; p += 8, len -= 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            c = _mm_crc32_u64(c, word);
+        }
+        crc = static_cast<uint32_t>(c);
+        for (; len > 0; ++p, --len)
+            crc = _mm_crc32_u8(crc, *p);
+        return crc;
+    }
+
+    bool have_hw() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+    }
+#elif defined(CRC32C_ARM)
+    __attribute__((target("+crc")))
+    uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, size_t len) {
+        for (; len >= 8; p += 8, len -= 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            crc = __crc32cd(crc, word);
+        }
+        for (; len > 0; ++p, --len)
+            crc = __crc32cb(crc, *p);
+        return crc;
+    }
+
+    bool have_hw() {
+        return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+    }
+#else
+    uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, size_t len) {
+        return crc32c_table(crc, p, len);
+    }
+
+    bool have_hw() {
+        return false;
+    }
+#endif
+
+    using Crc32cFn = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+    Crc32cFn select() {
+        return have_hw() ? crc32c_hw : crc32c_table;
+    }
+}
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+    static const Crc32cFn fn = select();
+    return ~fn(~crc, static_cast<const uint8_t*>(data), len);
+}
+
+bool crc32c_hardware() {
+    static const bool hw = have_hw();
+    return hw;
+}
@@ -0,0 +1,12 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli, poly 0x82F63B78 reflected). Uses the SSE4.2 or ARMv8 CRC
+// instructions when the CPU has them, a table otherwise. Pass the previous result
+// as `crc` to continue a running checksum, 0 to start one.
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+// True if crc32c() runs on the hardware instructions
+bool crc32c_hardware();
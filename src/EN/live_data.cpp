@@ -3,6 +3,7 @@
 #include "style.h"
 #include "sensor_recorder.h"
 #include "sensor_settings.h"
+#include "sensor_bus.h"
 #include "header.h"
 #include "live_data.h"
 
@@ -25,9 +26,52 @@ static lv_obj_t* temp_circle = nullptr;
 static lv_obj_t* cond_circle = nullptr;
 static lv_obj_t* pres_circle = nullptr;
 
-static void update_live_data_cb(lv_timer_t* timer) {
-    sensor_data_t latest = get_latest_sensor_data();
+static const uint64_t NOTHING_SHOWN = UINT64_MAX;
+static uint64_t shown_seq = NOTHING_SHOWN;
+
+enum class LiveStatus { Unknown, Reading, Unstable, NotResponding };
+static LiveStatus shown_status = LiveStatus::Unknown;
+
+// Health of the recorded probe. Direct simulation has no bus and is always healthy.
+static SensorHealth primary_health() {
+#ifndef _WIN32
+    SensorBus& bus = SensorBus::get_instance();
+    if (bus.is_open()) {
+        int address = bus.primary_address();
+        for (const auto& st : bus.get_status())
+            if (st.address == address) return st.health;
+    }
+#endif
+    return SensorHealth::Healthy;
+}
+
+static void update_status(LiveStatus status) {
+    if (status == shown_status) return;
+    shown_status = status;
+
+    switch (status) {
+    case LiveStatus::Reading:
+        lv_label_set_text(status_label, "Sensor Reading...");
+        break;
+    case LiveStatus::Unstable:
+        lv_label_set_text(status_label, "Sensor Unstable, Retrying...");
+        break;
+    default:
+        lv_label_set_text(status_label, "Sensor Not Responding");
+        break;
+    }
+
+    if (status == LiveStatus::NotResponding) {
+        lv_obj_add_flag(progressbar, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_clear_flag(error_icon, LV_OBJ_FLAG_HIDDEN);
+    }
+    else {
+        lv_obj_clear_flag(progressbar, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_add_flag(error_icon, LV_OBJ_FLAG_HIDDEN);
+    }
+}
 
+static void update_live_values(const sensor_data_t& latest) {
     char buf[64];
 
     if (temp_label && show_temperature) {
@@ -57,17 +101,27 @@ static void update_live_data_cb(lv_timer_t* timer) {
         snprintf(buf, sizeof(buf), "P: %f", latest.value3);
         lv_label_set_text(debug_pres_label, buf);
     }
+}
+
+static void update_live_data_cb(lv_timer_t* timer) {
+    sensor_sample_t sample = get_latest_sensor_sample();
+    const sensor_data_t& latest = sample.data;
 
+    // Labels are only rewritten when the recorder published a new sample
+    if (sample.seq != shown_seq) {
+        update_live_values(latest);
+        shown_seq = sample.seq;
+    }
+
+    // The last sample stays on screen while the bus retries, the status line tells why it is stale
     bool sensor_ok = (latest.value1 != 0 || latest.value2 != 0 || latest.value3 != 0);
-    if (sensor_ok) {
-        lv_label_set_text(status_label, "Sensor Reading...");
-        lv_obj_clear_flag(progressbar, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_add_flag(error_icon, LV_OBJ_FLAG_HIDDEN);
+    SensorHealth health = primary_health();
+    if (!sensor_ok || health == SensorHealth::Offline) {
+        update_status(LiveStatus::NotResponding);
+        sensor_ok = false;
     }
     else {
-        lv_label_set_text(status_label, "Sensor Not Responding");
-        lv_obj_add_flag(progressbar, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_clear_flag(error_icon, LV_OBJ_FLAG_HIDDEN);
+        update_status(health == SensorHealth::Degraded ? LiveStatus::Unstable : LiveStatus::Reading);
     }
 
     static bool toggle = false;
@@ -223,6 +277,8 @@ void create_live_data_screen() {
     update_timer = lv_timer_create(update_live_data_cb, 1000, NULL);
 
     ScreenManager::get_instance().register_screen(screen, [] {
+        shown_seq = NOTHING_SHOWN;
+        shown_status = LiveStatus::Unknown;
         if (update_timer) {
             lv_timer_del(update_timer);
             update_timer = nullptr;
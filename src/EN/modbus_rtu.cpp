@@ -0,0 +1,95 @@
+﻿#include "modbus_rtu.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+    struct Crc16Table {
+        uint16_t entries[256];
+
+        constexpr Crc16Table() : entries() {
+            for (int i = 0; i < 256; ++i) {
+                uint16_t crc = static_cast<uint16_t>(i);
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc & 1) ? static_cast<uint16_t>((crc >> 1) ^ 0xA001) : static_cast<uint16_t>(crc >> 1);
+                entries[i] = crc;
+            }
+        }
+    };
+
+    constexpr Crc16Table crc_table;
+
+    float decode_float(const uint8_t* p, bool word_swap) {
+        uint32_t hi = (static_cast<uint32_t>(p[0]) << 8) | p[1];
+        uint32_t lo = (static_cast<uint32_t>(p[2]) << 8) | p[3];
+        uint32_t bits = word_swap ? (lo << 16) | hi : (hi << 16) | lo;
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+}
+
+uint16_t modbus_crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; ++i)
+        crc = static_cast<uint16_t>((crc >> 8) ^ crc_table.entries[(crc ^ data[i]) & 0xFF]);
+    return crc;
+}
+
+size_t ModbusRtuProtocol::build_request(int address, uint8_t* buf, size_t size) const {
+    if (size < 8 || address < 1 || address > 247) return 0;
+
+    buf[0] = static_cast<uint8_t>(address);
+    buf[1] = function;
+    buf[2] = static_cast<uint8_t>(start_register >> 8);
+    buf[3] = static_cast<uint8_t>(start_register & 0xFF);
+    buf[4] = 0;
+    buf[5] = REGISTER_COUNT;
+
+    uint16_t crc = modbus_crc16(buf, 6);
+    buf[6] = static_cast<uint8_t>(crc & 0xFF);    // CRC is sent low byte first
+    buf[7] = static_cast<uint8_t>(crc >> 8);
+    return 8;
+}
+
+size_t ModbusRtuProtocol::split_frame(const uint8_t* buf, size_t len) const {
+    if (len < 2) return 0;
+
+    uint8_t code = buf[1];
+    if (code & 0x80)                                // Exception: addr, code, reason, crc
+        return len >= 5 ? 5 : 0;
+    if (code != READ_HOLDING_REGISTERS && code != READ_INPUT_REGISTERS)
+        return len;                                 // Line noise, drop what we have and resync
+
+    if (len < 3) return 0;
+    size_t frame = 5 + static_cast<size_t>(buf[2]);
+    return len >= frame ? frame : 0;
+}
+
+bool ModbusRtuProtocol::parse_response(int address, const uint8_t* frame, size_t len, sensor_data_t* out) const {
+    if (len < 5) return false;
+
+    uint16_t crc = static_cast<uint16_t>(frame[len - 2] | (frame[len - 1] << 8));
+    if (modbus_crc16(frame, len - 2) != crc) {
+        fprintf(stderr, "Modbus CRC mismatch from address %d\n", address);
+        return false;
+    }
+    if (frame[0] != address) return false;
+    if (frame[1] & 0x80) {
+        fprintf(stderr, "Modbus exception %d from address %d\n", frame[2], address);
+        return false;
+    }
+    if (frame[1] != function || frame[2] != REGISTER_COUNT * 2 || len != 5u + REGISTER_COUNT * 2)
+        return false;
+
+    const uint8_t* regs = frame + 3;
+    out->value1 = decode_float(regs, word_swap);
+    out->value2 = decode_float(regs + 4, word_swap);
+    out->value3 = decode_float(regs + 8, word_swap);
+    return true;
+}
+
+ModbusRtuProtocol& modbus_rtu_protocol() {
+    static ModbusRtuProtocol instance;
+    return instance;
+}
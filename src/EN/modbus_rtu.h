@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include "sensor_protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-16/MODBUS (poly 0xA001 reflected, init 0xFFFF), table driven
+uint16_t modbus_crc16(const uint8_t* data, size_t len);
+
+// Binary Modbus-RTU backend. All three channels are read with a single
+// "read registers" request: six consecutive 16-bit registers holding
+// temperature, conductivity and pressure as IEEE-754 floats.
+class ModbusRtuProtocol : public SensorProtocol {
+public:
+    static const uint8_t READ_HOLDING_REGISTERS = 0x03;
+    static const uint8_t READ_INPUT_REGISTERS = 0x04;
+    static const uint16_t REGISTER_COUNT = 6;
+
+    const char* name() const override { return "MODBUS"; }
+    size_t build_request(int address, uint8_t* buf, size_t size) const override;
+    size_t split_frame(const uint8_t* buf, size_t len) const override;
+    bool parse_response(int address, const uint8_t* frame, size_t len, sensor_data_t* out) const override;
+    bool from_address(int address, const uint8_t* frame, size_t len) const override { return len > 0 && frame[0] == address; }
+
+    void set_start_register(uint16_t reg) { start_register = reg; }
+    void set_function(uint8_t code) { function = code; }
+    void set_word_swap(bool swap) { word_swap = swap; }   // Low word first (common on probes)
+
+private:
+    uint16_t start_register = 0;
+    uint8_t function = READ_HOLDING_REGISTERS;
+    bool word_swap = false;
+};
+
+ModbusRtuProtocol& modbus_rtu_protocol();
@@ -0,0 +1,48 @@
+﻿#include "periodic_timer.h"
+#include "serial_engine.h"
+
+#include <errno.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+PeriodicTimer::PeriodicTimer(int period_ms)
+    : period_ns(std::max(period_ms, 1) * 1000000LL) {
+}
+
+void PeriodicTimer::start() {
+    next_ns = monotonic_ns() + period_ns;
+    counters = Stats();
+}
+
+static void sleep_until_ns(int64_t deadline_ns) {
+#ifndef _WIN32
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(deadline_ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(deadline_ns % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline_ns)));
+#endif
+}
+
+void PeriodicTimer::wait_next() {
+    int64_t now = monotonic_ns();
+
+    // Late by more than a period: drop the missed ticks instead of bursting to catch up
+    if (now - next_ns >= period_ns) {
+        int64_t missed = (now - next_ns) / period_ns;
+        counters.overruns += missed;
+        next_ns += missed * period_ns;
+    }
+
+    if (now < next_ns) sleep_until_ns(next_ns);
+
+    int64_t jitter = monotonic_ns() - next_ns;
+    counters.jitter_max_ns = std::max(counters.jitter_max_ns, jitter);
+    counters.jitter_sum_ns += jitter;
+    ++counters.ticks;
+
+    next_ns += period_ns;
+}
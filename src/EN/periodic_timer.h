@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// Fixed-rate scheduler on CLOCK_MONOTONIC. Ticks are absolute (start + k * period),
+// so the time spent on work between ticks does not accumulate as drift.
+class PeriodicTimer {
+public:
+    struct Stats {
+        uint64_t ticks = 0;
+        uint64_t overruns = 0;      // Ticks skipped because the work took longer than a period
+        int64_t jitter_max_ns = 0;  // Wake-up latency after the scheduled tick
+        int64_t jitter_sum_ns = 0;
+
+        int64_t jitter_avg_ns() const { return ticks ? jitter_sum_ns / static_cast<int64_t>(ticks) : 0; }
+    };
+
+    explicit PeriodicTimer(int period_ms);
+
+    void start();                               // First tick is one period from now
+    void wait_next();                           // Sleeps until the next tick
+    int64_t next_tick_ns() const { return next_ns; }
+    int period_ms() const { return static_cast<int>(period_ns / 1000000); }
+
+    const Stats& stats() const { return counters; }
+
+private:
+    int64_t period_ns;
+    int64_t next_ns = 0;
+    Stats counters;
+};
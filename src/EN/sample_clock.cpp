@@ -0,0 +1,43 @@
+﻿#include "sample_clock.h"
+#include "serial_engine.h"
+
+#include <atomic>
+#include <chrono>
+
+static const int64_t REFRESH_PERIOD_NS = 10LL * 1000000000LL;
+
+static std::atomic<int64_t> offset_ns{ 0 };
+static std::atomic<int64_t> refreshed_at_ns{ 0 };
+
+static int64_t realtime_ns() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+void sample_clock_refresh() {
+    // Bracket the realtime read with two monotonic reads and keep the tightest pair
+    int64_t best_offset = 0;
+    int64_t best_gap = INT64_MAX;
+    for (int i = 0; i < 3; ++i) {
+        int64_t m1 = monotonic_ns();
+        int64_t r = realtime_ns();
+        int64_t m2 = monotonic_ns();
+        if (m2 - m1 < best_gap) {
+            best_gap = m2 - m1;
+            best_offset = r - (m1 + (m2 - m1) / 2);
+        }
+    }
+    offset_ns.store(best_offset, std::memory_order_relaxed);
+    refreshed_at_ns.store(monotonic_ns(), std::memory_order_relaxed);
+}
+
+void sample_clock_refresh_if_stale() {
+    int64_t last = refreshed_at_ns.load(std::memory_order_relaxed);
+    if (last == 0 || monotonic_ns() - last > REFRESH_PERIOD_NS)
+        sample_clock_refresh();
+}
+
+int64_t monotonic_to_realtime_ns(int64_t mono_ns) {
+    sample_clock_refresh_if_stale();
+    return mono_ns + offset_ns.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// Samples are stamped with CLOCK_MONOTONIC nanoseconds, which never jump when the
+// wall clock is changed (apply_datetime, sync_time_from_api). Wall-clock time is
+// only derived when a sample is logged, through a periodically refreshed offset.
+
+// Re-measures the CLOCK_REALTIME - CLOCK_MONOTONIC offset. Call after setting the time.
+void sample_clock_refresh();
+
+// Refreshes the offset if it is older than a few seconds
+void sample_clock_refresh_if_stale();
+
+int64_t monotonic_to_realtime_ns(int64_t mono_ns);
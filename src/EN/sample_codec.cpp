@@ -0,0 +1,341 @@
+﻿#include "sample_codec.h"
+#include "crc32c.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+    struct CodecFileHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t block_size;
+    };
+
+    enum FrameKind : uint8_t { FRAME_RAW = 0, FRAME_GORILLA = 1 };
+
+    const size_t KIND_BYTES = 4;        // Kind plus padding, keeps the block header aligned
+    const int STREAMS = 4;
+
+    // Largest frame a decoder accepts; a raw block plus headroom
+    const uint32_t MAX_FRAME_BYTES = 2 * SAMPLE_LOG_BLOCK;
+
+    // MSB-first bit packing
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+        void put(uint64_t value, int n) {
+            if (n > 32) {
+                put(value >> 32, n - 32);
+                n = 32;
+            }
+            if (n == 0) return;
+            acc = (acc << n) | (value & ((1ULL << n) - 1));
+            bits += n;
+            while (bits >= 8) {
+                bits -= 8;
+                out.push_back(static_cast<uint8_t>(acc >> bits));
+            }
+        }
+
+        void flush() {
+            if (bits > 0) out.push_back(static_cast<uint8_t>(acc << (8 - bits)));
+            bits = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+        uint64_t acc = 0;
+        int bits = 0;
+    };
+
+    class BitReader {
+    public:
+        BitReader(const uint8_t* p, size_t size) : p(p), end(p + size) {}
+
+        uint64_t get(int n) {
+            if (n > 32) {
+                uint64_t hi = get(n - 32);
+                return (hi << 32) | get(32);
+            }
+            while (bits < n) {
+                if (p < end) acc = (acc << 8) | *p++;
+                else {
+                    acc <<= 8;
+                    overrun = true;
+                }
+                bits += 8;
+            }
+            bits -= n;
+            return (acc >> bits) & ((1ULL << n) - 1);
+        }
+
+        bool failed() const { return overrun; }
+
+    private:
+        const uint8_t* p;
+        const uint8_t* end;
+        uint64_t acc = 0;
+        int bits = 0;
+        bool overrun = false;
+    };
+
+    void encode_times(const uint32_t* dt, uint32_t count, BitWriter& w) {
+        if (count == 0) return;
+        w.put(dt[0], 32);
+        int64_t prev_delta = 0;
+        for (uint32_t i = 1; i < count; ++i) {
+            int64_t delta = static_cast<int64_t>(dt[i]) - dt[i - 1];
+            int64_t dod = delta - prev_delta;
+            prev_delta = delta;
+
+            if (dod == 0) w.put(0, 1);
+            else if (dod >= -63 && dod <= 64) { w.put(0x2, 2); w.put(static_cast<uint64_t>(dod + 63), 7); }
+            else if (dod >= -255 && dod <= 256) { w.put(0x6, 3); w.put(static_cast<uint64_t>(dod + 255), 9); }
+            else if (dod >= -2047 && dod <= 2048) { w.put(0xE, 4); w.put(static_cast<uint64_t>(dod + 2047), 12); }
+            else { w.put(0xF, 4); w.put(static_cast<uint64_t>(dod), 64); }
+        }
+    }
+
+    void decode_times(BitReader& r, uint32_t count, uint32_t* dt) {
+        if (count == 0) return;
+        dt[0] = static_cast<uint32_t>(r.get(32));
+        int64_t delta = 0;
+        for (uint32_t i = 1; i < count; ++i) {
+            int64_t dod;
+            if (r.get(1) == 0) dod = 0;
+            else if (r.get(1) == 0) dod = static_cast<int64_t>(r.get(7)) - 63;
+            else if (r.get(1) == 0) dod = static_cast<int64_t>(r.get(9)) - 255;
+            else if (r.get(1) == 0) dod = static_cast<int64_t>(r.get(12)) - 2047;
+            else dod = static_cast<int64_t>(r.get(64));
+            delta += dod;
+            dt[i] = static_cast<uint32_t>(dt[i - 1] + delta);
+        }
+    }
+
+    // x is never 0
+#if defined(__GNUC__)
+    int leading_zeros(uint32_t x) { return __builtin_clz(x); }
+    int trailing_zeros(uint32_t x) { return __builtin_ctz(x); }
+#else
+    int leading_zeros(uint32_t x) { int n = 0; while (!(x & 0x80000000u)) { x <<= 1; ++n; } return n; }
+    int trailing_zeros(uint32_t x) { int n = 0; while (!(x & 1u)) { x >>= 1; ++n; } return n; }
+#endif
+
+    void encode_floats(const float* values, uint32_t count, BitWriter& w) {
+        if (count == 0) return;
+        uint32_t prev;
+        memcpy(&prev, &values[0], sizeof(prev));
+        w.put(prev, 32);
+
+        int window_lead = -1, window_trail = 0;
+        for (uint32_t i = 1; i < count; ++i) {
+            uint32_t cur;
+            memcpy(&cur, &values[i], sizeof(cur));
+            uint32_t x = cur ^ prev;
+            prev = cur;
+
+            if (x == 0) {
+                w.put(0, 1);
+                continue;
+            }
+            int lead = leading_zeros(x);
+            int trail = trailing_zeros(x);
+            if (window_lead >= 0 && lead >= window_lead && trail >= window_trail) {
+                w.put(0x2, 2);      // '10': meaningful bits fit the previous window
+                w.put(x >> window_trail, 32 - window_lead - window_trail);
+            }
+            else {
+                int len = 32 - lead - trail;
+                w.put(0x3, 2);      // '11': new window
+                w.put(static_cast<uint64_t>(lead), 5);
+                w.put(static_cast<uint64_t>(len - 1), 5);
+                w.put(x >> trail, len);
+                window_lead = lead;
+                window_trail = trail;
+            }
+        }
+    }
+
+    void decode_floats(BitReader& r, uint32_t count, float* values) {
+        if (count == 0) return;
+        uint32_t prev = static_cast<uint32_t>(r.get(32));
+        memcpy(&values[0], &prev, sizeof(prev));
+
+        int window_lead = 0, window_trail = 0;
+        for (uint32_t i = 1; i < count; ++i) {
+            if (r.get(1) != 0) {
+                uint32_t x;
+                if (r.get(1) == 0) {
+                    x = static_cast<uint32_t>(r.get(32 - window_lead - window_trail)) << window_trail;
+                }
+                else {
+                    window_lead = static_cast<int>(r.get(5));
+                    int len = static_cast<int>(r.get(5)) + 1;
+                    window_trail = 32 - window_lead - len;
+                    if (window_trail < 0) window_trail = 0;
+                    x = static_cast<uint32_t>(r.get(len)) << window_trail;
+                }
+                prev ^= x;
+            }
+            memcpy(&values[i], &prev, sizeof(prev));
+        }
+    }
+
+    // Column pointers of a block laid out for its capacity
+    struct Columns {
+        uint32_t* dt_us;
+        float* ch[3];
+    };
+
+    Columns columns_of(uint8_t* block, uint32_t capacity) {
+        uint8_t* c = block + SAMPLE_LOG_HEADER;
+        Columns cols;
+        cols.dt_us = reinterpret_cast<uint32_t*>(c);
+        for (int i = 0; i < 3; ++i)
+            cols.ch[i] = reinterpret_cast<float*>(c + 4 * capacity * (i + 1));
+        return cols;
+    }
+}
+
+void gorilla_encode_block(const uint8_t* block, std::vector<uint8_t>& out) {
+    LogBlockHeader h;
+    memcpy(&h, block, sizeof(h));
+
+    size_t start = out.size();
+    if (!log_header_valid(h)) {
+        out.resize(start + KIND_BYTES);
+        out[start] = FRAME_RAW;
+        out.insert(out.end(), block, block + SAMPLE_LOG_BLOCK);
+        return;
+    }
+
+    out.resize(start + KIND_BYTES + sizeof(h) + STREAMS * sizeof(uint32_t));
+    out[start] = FRAME_GORILLA;
+    memcpy(&out[start + KIND_BYTES], &h, sizeof(h));
+    size_t lengths_at = start + KIND_BYTES + sizeof(h);
+
+    // The block is read through a copy so its columns are aligned
+    uint8_t copy[SAMPLE_LOG_BLOCK];
+    memcpy(copy, block, sizeof(copy));
+    Columns cols = columns_of(copy, h.capacity);
+
+    for (int s = 0; s < STREAMS; ++s) {
+        size_t before = out.size();
+        BitWriter w(out);
+        if (s == 0) encode_times(cols.dt_us, h.count, w);
+        else encode_floats(cols.ch[s - 1], h.count, w);
+        w.flush();
+
+        uint32_t bytes = static_cast<uint32_t>(out.size() - before);
+        memcpy(&out[lengths_at + s * sizeof(uint32_t)], &bytes, sizeof(bytes));
+    }
+}
+
+bool gorilla_decode_block(const uint8_t* payload, size_t size, uint8_t* block) {
+    if (size < KIND_BYTES) return false;
+    memset(block, 0, SAMPLE_LOG_BLOCK);
+
+    if (payload[0] == FRAME_RAW) {
+        if (size != KIND_BYTES + SAMPLE_LOG_BLOCK) return false;
+        memcpy(block, payload + KIND_BYTES, SAMPLE_LOG_BLOCK);
+        return true;
+    }
+    if (payload[0] != FRAME_GORILLA || size < KIND_BYTES + SAMPLE_LOG_HEADER + STREAMS * sizeof(uint32_t))
+        return false;
+
+    LogBlockHeader h;
+    memcpy(&h, payload + KIND_BYTES, sizeof(h));
+    if (!log_header_valid(h)) return false;
+    memcpy(block, &h, sizeof(h));
+
+    uint32_t lengths[STREAMS];
+    memcpy(lengths, payload + KIND_BYTES + sizeof(h), sizeof(lengths));
+    const uint8_t* p = payload + KIND_BYTES + sizeof(h) + sizeof(lengths);
+    const uint8_t* end = payload + size;
+
+    Columns cols = columns_of(block, h.capacity);
+    for (int s = 0; s < STREAMS; ++s) {
+        if (lengths[s] > static_cast<size_t>(end - p)) return false;
+        BitReader r(p, lengths[s]);
+        if (s == 0) decode_times(r, h.count, cols.dt_us);
+        else decode_floats(r, h.count, cols.ch[s - 1]);
+        if (r.failed()) return false;
+        p += lengths[s];
+    }
+
+    if (h.version == SAMPLE_LOG_VERSION) {
+        LogBlock* b = reinterpret_cast<LogBlock*>(block);
+        for (uint32_t i = 0; i < h.count; ++i)
+            b->crc[i] = log_record_crc(i > 0 ? b->crc[i - 1] : log_chain_seed(h), *b, i);
+    }
+    return true;
+}
+
+bool gorilla_encode_file(const std::string& in_path, const std::string& out_path) {
+    FILE* in = fopen(in_path.c_str(), "rb");
+    if (!in) return false;
+    FILE* out = fopen(out_path.c_str(), "wb");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    CodecFileHeader fh = { SAMPLE_CODEC_MAGIC, SAMPLE_CODEC_VERSION, SAMPLE_LOG_BLOCK };
+    bool ok = fwrite(&fh, sizeof(fh), 1, out) == 1;
+
+    uint8_t block[SAMPLE_LOG_BLOCK];
+    std::vector<uint8_t> payload;
+    while (ok && fread(block, sizeof(block), 1, in) == 1) {
+        payload.clear();
+        gorilla_encode_block(block, payload);
+        CodecFrameHeader frame = { static_cast<uint32_t>(payload.size()), crc32c(0, payload.data(), payload.size()) };
+        ok = fwrite(&frame, sizeof(frame), 1, out) == 1 &&
+            fwrite(payload.data(), payload.size(), 1, out) == 1;
+    }
+    ok = ok && !ferror(in);
+    fclose(in);
+    ok = fflush(out) == 0 && ok;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(out)) == 0;     // The plain segment is deleted once this is renamed
+#endif
+    ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
+bool GorillaReader::open(const char* path) {
+    close();
+    file = fopen(path, "rb");
+    if (!file) return false;
+
+    CodecFileHeader fh;
+    if (fread(&fh, sizeof(fh), 1, file) != 1 || fh.magic != SAMPLE_CODEC_MAGIC ||
+        fh.version != SAMPLE_CODEC_VERSION || fh.block_size != SAMPLE_LOG_BLOCK) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void GorillaReader::close() {
+    if (file) fclose(file);
+    file = nullptr;
+}
+
+bool GorillaReader::next(uint8_t* block) {
+    if (!file) return false;
+
+    CodecFrameHeader frame;
+    if (fread(&frame, sizeof(frame), 1, file) != 1 || frame.bytes > MAX_FRAME_BYTES) return false;
+    payload.resize(frame.bytes);
+    if (frame.bytes > 0 && fread(payload.data(), frame.bytes, 1, file) != 1) return false;
+    if (crc32c(0, payload.data(), payload.size()) != frame.crc) {
+        fprintf(stderr, "Sample log: damaged frame in compressed segment\n");
+        return false;
+    }
+    return gorilla_decode_block(payload.data(), payload.size(), block);
+}
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "sample_log.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define SAMPLE_CODEC_SUFFIX ".gor"
+#define SAMPLE_CODEC_MAGIC  0x4C524F47u     // "GORL"
+#define SAMPLE_CODEC_VERSION 1
+
+// Gorilla-style encoding of closed log segments ("seg-000001.bin.gor").
+//
+// The file is a short header followed by one frame per 4 KiB log block, so it can be
+// decoded a block at a time. A frame holds the block header verbatim and four bit
+// streams, one per column, each with its byte length up front so a reader can decode
+// (or skip) a column on its own:
+//   dt_us         delta-of-delta, '0' for a steady rate, 7/9/12-bit buckets otherwise
+//   temp/cond/pres XOR with the previous value, leading/trailing zero windows reused
+// The CRC column of version 2 blocks is not stored; it is rebuilt on decode. Frames
+// carry their own CRC-32C, and a block that is not a valid log block is stored raw.
+
+struct CodecFrameHeader {
+    uint32_t bytes;             // Payload size
+    uint32_t crc;               // CRC-32C of the payload
+};
+
+// Encodes one log block (SAMPLE_LOG_BLOCK bytes) as a frame payload
+void gorilla_encode_block(const uint8_t* block, std::vector<uint8_t>& out);
+
+// Decodes a frame payload back into a log block. Returns false if it is damaged.
+bool gorilla_decode_block(const uint8_t* payload, size_t size, uint8_t* block);
+
+// Writes `out_path` from the blocks of the plain segment `in_path`
+bool gorilla_encode_file(const std::string& in_path, const std::string& out_path);
+
+// Streaming decoder, one block per call
+class GorillaReader {
+public:
+    GorillaReader() = default;
+    ~GorillaReader() { close(); }
+
+    bool open(const char* path);
+    void close();
+
+    // Decodes the next block into `block` (SAMPLE_LOG_BLOCK bytes). False at the end or on a damaged frame.
+    bool next(uint8_t* block);
+
+private:
+    FILE* file = nullptr;
+    std::vector<uint8_t> payload;
+
+    GorillaReader(const GorillaReader&) = delete;
+    GorillaReader& operator=(const GorillaReader&) = delete;
+};
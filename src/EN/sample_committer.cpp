@@ -0,0 +1,105 @@
+﻿#include "sample_committer.h"
+#include "serial_engine.h"
+
+#include <algorithm>
+#include <chrono>
+
+bool SampleCommitter::start(const SampleStoreConfig& config, int samples, int ms) {
+    stop();
+    if (!store.open(config)) return false;
+
+    batch_samples = static_cast<size_t>(std::max(samples, 1));
+    batch_samples = std::min(batch_samples, queue.capacity() / 2);
+    batch_ms = std::max(ms, 0);
+    counters = Stats();
+    queue_full.store(0);
+
+    running.store(true);
+    writer = std::thread([this] { run(); });
+    return true;
+}
+
+void SampleCommitter::stop() {
+    if (running.exchange(false)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        wake.notify_one();
+    }
+    if (writer.joinable()) writer.join();
+    store.close();
+}
+
+bool SampleCommitter::push(int64_t realtime_ns, const sensor_data_t& data) {
+    if (!queue.try_push({ realtime_ns, data })) {
+        queue_full.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Only a full batch wakes the writer early; the first push to do so takes the lock
+    if (queue.size() >= batch_samples && !wake_pending.exchange(true)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        wake.notify_one();
+    }
+    return true;
+}
+
+SampleCommitter::Stats SampleCommitter::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    Stats s = counters;
+    s.dropped += queue_full.load();
+    return s;
+}
+
+void SampleCommitter::run() {
+    using clock = std::chrono::steady_clock;
+
+    while (running.load()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto ready = [this] { return !running.load() || queue.size() >= batch_samples; };
+            if (batch_ms > 0)
+                wake.wait_until(lock, clock::now() + std::chrono::milliseconds(batch_ms), ready);
+            else
+                wake.wait(lock, ready);         // Commit on batch size only
+        }
+        write_batch();
+
+        // Re-armed only once the queue is drained: a push that crossed the threshold during
+        // write_batch() found nobody waiting, and the size check in ready() catches it instead
+        wake_pending.store(false);
+    }
+    write_batch();      // Whatever was queued before stop()
+}
+
+// Drains the queue into the store and commits it once
+void SampleCommitter::write_batch() {
+    if (queue.size() == 0) return;
+
+    int64_t start_ns = monotonic_ns();
+    uint64_t added = 0;
+    uint64_t failed = 0;
+    Entry e;
+    while (queue.try_pop(e)) {
+        if (store.add(e.realtime_ns, e.data)) ++added;
+        else ++failed;
+    }
+    if (!store.commit()) {
+        failed += added;
+        added = 0;
+    }
+    int64_t latency_us = (monotonic_ns() - start_ns) / 1000;
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    Stats& s = counters;
+    s.dropped += failed;
+    if (added == 0) return;
+    if (s.batches == 0 || latency_us < s.commit_min_us) s.commit_min_us = latency_us;
+    if (latency_us > s.commit_max_us) s.commit_max_us = latency_us;
+    s.commit_sum_us += latency_us;
+    s.batch_max = std::max(s.batch_max, added);
+    s.samples += added;
+    ++s.batches;
+}
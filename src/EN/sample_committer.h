@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include "sample_store.h"
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Group commit for the sample store. The recorder thread hands samples over through a
+// lock-free queue and never touches the file; a writer thread drains the queue and
+// commits once per batch (every `batch_samples` samples or `batch_ms` milliseconds,
+// whichever comes first; 0 ms means on size only), so the cost of a write and of an fdatasync() is shared by
+// the whole batch instead of paid per sample.
+class SampleCommitter {
+public:
+    struct Stats {
+        uint64_t batches = 0;
+        uint64_t samples = 0;
+        uint64_t dropped = 0;           // Samples lost because the queue was full or a write failed
+        uint64_t batch_max = 0;
+        int64_t commit_min_us = 0;      // Time from the first write of a batch to its commit returning
+        int64_t commit_max_us = 0;
+        int64_t commit_sum_us = 0;
+
+        uint64_t batch_avg() const { return batches ? samples / batches : 0; }
+        int64_t commit_avg_us() const { return batches ? commit_sum_us / static_cast<int64_t>(batches) : 0; }
+    };
+
+    explicit SampleCommitter(size_t queue_pow2 = 4096) : queue(queue_pow2) {}
+    ~SampleCommitter() { stop(); }
+
+    // Opens the store and starts the writer thread
+    bool start(const SampleStoreConfig& config, int batch_samples, int batch_ms);
+
+    // Commits everything still queued, then closes the store
+    void stop();
+
+    // Producer side, never blocks. Returns false if the sample was dropped.
+    bool push(int64_t realtime_ns, const sensor_data_t& data);
+
+    // Consistent once stop() has returned
+    Stats stats() const;
+
+private:
+    struct Entry {
+        int64_t realtime_ns;
+        sensor_data_t data;
+    };
+
+    void run();
+    void write_batch();
+
+    SampleStore store;
+    SpscQueue<Entry> queue;
+    size_t batch_samples = 1;
+    int batch_ms = 0;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> wake_pending{ false };
+    std::atomic<uint64_t> queue_full{ 0 };
+
+    mutable std::mutex stats_mutex;
+    Stats counters;
+
+    SampleCommitter(const SampleCommitter&) = delete;
+    SampleCommitter& operator=(const SampleCommitter&) = delete;
+};
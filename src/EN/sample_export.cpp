@@ -0,0 +1,268 @@
+﻿#include "sample_export.h"
+#include "sample_clock.h"
+#include "serial_engine.h"
+#include "text_format.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+std::string export_file_name(const std::string& dir, ExportFormat format) {
+    time_t now = time(nullptr);
+    struct tm tm_now;
+#ifdef _WIN32
+    localtime_s(&tm_now, &now);
+#else
+    localtime_r(&now, &tm_now);
+#endif
+    char name[48];
+    strftime(name, sizeof(name), "/sensor-%Y%m%d-%H%M%S", &tm_now);
+    return dir + name + (format == ExportFormat::Csv ? ".csv" : ".jsonl");
+}
+
+#ifndef _WIN32
+
+static const char* const CHANNEL_NAMES[3] = { "temperature", "conductivity", "pressure" };
+
+bool SampleExporter::start(const ExportRequest& request) {
+    if (running()) return false;
+    wait();
+
+    part_path = request.path + ".part";
+    fd = ::open(part_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("export open");
+        return false;
+    }
+
+    req = request;
+    time_format = TimestampFormatter(req.format == ExportFormat::JsonLines ? 'T' : ' ');
+    for (auto& b : buffers) {
+        b.data.resize(EXPORT_BUFFER_BYTES);
+        b.used = 0;
+    }
+    front = &buffers[0];
+    pending = nullptr;
+    finishing = false;
+    write_error = 0;
+    cancelled.store(false);
+
+    counters = ExportProgress();
+    publish(ExportState::Running);
+
+    writer = std::thread([this] { flush_loop(); });
+    worker = std::thread([this] { run(); });
+    return true;
+}
+
+void SampleExporter::wait() {
+    if (worker.joinable()) worker.join();
+}
+
+void SampleExporter::publish(ExportState state) {
+    counters.state = state;
+    status.store(counters);
+}
+
+void SampleExporter::run() {
+    std::vector<SegmentInfo> segments = list_segments(req.dir);
+
+    // The percentage is measured over the part of the range that can hold data
+    begin_ns = req.from_ns;
+    for (const auto& seg : segments) {
+        if (seg.max_ts_ns < req.from_ns) continue;
+        if (seg.first_ts_ns != INT64_MIN) begin_ns = std::max(begin_ns, seg.first_ts_ns);
+        break;
+    }
+    end_ns = std::min(req.to_ns, monotonic_to_realtime_ns(monotonic_ns()));
+
+    write_header();
+
+    for (const auto& seg : segments) {
+        if (cancelled.load()) break;
+        if (seg.max_ts_ns < req.from_ns) continue;
+        if (seg.first_ts_ns != INT64_MIN && seg.first_ts_ns >= req.to_ns) break;
+
+        // One segment is mapped (or inflated) at a time
+        SampleLogView view;
+        if (!view.open(seg.path.c_str())) continue;
+        view.for_since(req.from_ns, [this](const LogSpan& s) {
+            if (!cancelled.load()) write_rows(s);
+        });
+        if (seg.max_ts_ns >= req.to_ns) break;
+    }
+
+    // The last, partly filled buffer goes out with the rest
+    bool ok = !cancelled.load() && hand_over();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishing = true;
+    }
+    changed.notify_all();
+    writer.join();
+
+    ok = ok && write_error == 0;
+    if (ok && fsync(fd) != 0) {
+        write_error = errno;
+        ok = false;
+    }
+    ::close(fd);
+    fd = -1;
+    if (ok && rename(part_path.c_str(), req.path.c_str()) != 0) {
+        write_error = errno;
+        ok = false;
+    }
+
+    if (!ok) {
+        unlink(part_path.c_str());
+        counters.error = write_error;
+        if (write_error) fprintf(stderr, "export %s: %s\n", req.path.c_str(), strerror(write_error));
+        publish(write_error ? ExportState::Failed : ExportState::Cancelled);
+        return;
+    }
+    counters.percent = 100;
+    publish(ExportState::Done);
+}
+
+void SampleExporter::write_header() {
+    if (req.format != ExportFormat::Csv) return;
+
+    std::string line = "time";
+    for (int c = 0; c < 3; ++c)
+        if (req.channels & (1u << c)) line += std::string(",") + CHANNEL_NAMES[c];
+    line += '\n';
+    put(line.c_str(), line.size());
+}
+
+static char* put_text(char* p, const char* text) {
+    size_t n = strlen(text);
+    memcpy(p, text, n);
+    return p + n;
+}
+
+// Rows are formatted in place at the end of the buffer being filled, so a row costs
+// no allocation and no stdio; the buffer goes to the writer as a single write()
+void SampleExporter::write_rows(const LogSpan& s) {
+    const float* columns[3] = { s.temp, s.cond, s.pres };
+    bool json = req.format == ExportFormat::JsonLines;
+
+    for (size_t i = 0; i < s.count; ++i) {
+        int64_t ts = s.ts(i);
+        if (ts < req.from_ns) continue;
+        if (ts >= req.to_ns) break;
+
+        if (front->used + EXPORT_ROW_MAX > front->data.size() && !hand_over()) return;
+        char* row = front->data.data() + front->used;
+        char* p = row;
+
+        if (json) p = put_text(p, "{\"time\":\"");
+        p += time_format.format(ts, p);
+        if (json) *p++ = '"';
+
+        for (int c = 0; c < 3; ++c) {
+            if (!(req.channels & (1u << c))) continue;
+            float v = columns[c][i];
+            *p++ = ',';
+            if (json) {
+                *p++ = '"';
+                p = put_text(p, CHANNEL_NAMES[c]);
+                *p++ = '"';
+                *p++ = ':';
+            }
+            if (isfinite(v)) p += format_float(v, p);
+            else if (json) p = put_text(p, "null");
+        }
+        if (json) *p++ = '}';
+        *p++ = '\n';
+
+        size_t n = static_cast<size_t>(p - row);
+        front->used += n;
+        counters.bytes += n;
+        ++counters.samples;
+        counters.last_ts_ns = ts;
+    }
+
+    if (counters.samples == 0) return;
+    if (begin_ns == INT64_MIN) begin_ns = s.ts(0);
+    if (end_ns > begin_ns) {
+        int64_t done = std::min(counters.last_ts_ns, end_ns) - begin_ns;
+        counters.percent = static_cast<int32_t>(std::max<int64_t>(0, done / ((end_ns - begin_ns) / 100 + 1)));
+        counters.percent = std::min(counters.percent, 99);
+    }
+    publish(ExportState::Running);
+}
+
+void SampleExporter::put(const char* text, size_t n) {
+    if (front->used + n > front->data.size() && !hand_over()) return;
+    memcpy(front->data.data() + front->used, text, n);
+    front->used += n;
+    counters.bytes += n;
+}
+
+// Passes the filled buffer to the writer and continues in the other one. Only waits if
+// the writer is still busy with the previous buffer, i.e. the disk is the bottleneck.
+bool SampleExporter::hand_over() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return pending == nullptr || write_error != 0; });
+    if (write_error != 0) {
+        cancelled.store(true);      // Stops the worker; the state still reports the failure
+        return false;
+    }
+    pending = front;
+    front = (front == &buffers[0]) ? &buffers[1] : &buffers[0];
+    front->used = 0;
+    lock.unlock();
+    changed.notify_all();
+    return true;
+}
+
+void SampleExporter::flush_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        changed.wait(lock, [this] { return pending != nullptr || finishing; });
+        if (!pending) break;
+
+        Buffer* b = pending;
+        int error = write_error;
+        lock.unlock();
+
+        size_t done = 0;
+        while (error == 0 && done < b->used) {
+            ssize_t n = ::write(fd, b->data.data() + done, b->used - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                error = errno;
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+
+        lock.lock();
+        write_error = error;
+        pending = nullptr;
+        changed.notify_all();
+    }
+}
+
+#else
+
+// The Windows simulator has no sample store to export
+bool SampleExporter::start(const ExportRequest&) { return false; }
+void SampleExporter::wait() {}
+void SampleExporter::publish(ExportState state) { counters.state = state; status.store(counters); }
+void SampleExporter::run() {}
+void SampleExporter::write_header() {}
+void SampleExporter::write_rows(const LogSpan&) {}
+void SampleExporter::put(const char*, size_t) {}
+bool SampleExporter::hand_over() { return false; }
+void SampleExporter::flush_loop() {}
+
+#endif
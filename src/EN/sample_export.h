@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include "sample_store.h"
+#include "seqlock.h"
+#include "text_format.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streaming export of recorded samples to a CSV or JSON-lines file (e.g. on a USB stick).
+//
+// A worker thread walks the segments overlapping the requested range one at a time and
+// formats rows into one of two fixed buffers while a writer thread flushes the other, so
+// memory stays at two buffers plus the segment being read no matter how long the range
+// is, and the disk and the formatting overlap. The file is written as "<path>.part" and
+// renamed once it is complete and synced. Progress is published through a SeqLock that
+// the UI polls; cancel() stops at the next span and removes the partial file.
+
+#define EXPORT_BUFFER_BYTES (256 * 1024)
+#define EXPORT_ROW_MAX      160     // Longest JSON row: time and three named channels
+
+enum class ExportFormat {
+    Csv,            // "time,temperature,conductivity,pressure" header, one row per sample
+    JsonLines       // One object per line, NaN written as null
+};
+
+// Channel selection
+#define EXPORT_TEMPERATURE  0x1u
+#define EXPORT_CONDUCTIVITY 0x2u
+#define EXPORT_PRESSURE     0x4u
+#define EXPORT_ALL          0x7u
+
+struct ExportRequest {
+    std::string dir = SAMPLE_STORE_DIR;
+    std::string path;
+    ExportFormat format = ExportFormat::Csv;
+    int64_t from_ns = INT64_MIN;        // Wall clock, [from_ns, to_ns)
+    int64_t to_ns = INT64_MAX;
+    unsigned channels = EXPORT_ALL;
+};
+
+enum class ExportState : uint32_t { Idle, Running, Done, Cancelled, Failed };
+
+struct ExportProgress {
+    ExportState state = ExportState::Idle;
+    int32_t error = 0;                  // errno of a failed export
+    uint64_t samples = 0;
+    uint64_t bytes = 0;
+    int64_t last_ts_ns = 0;
+    int32_t percent = 0;                // Share of the time range covered so far
+};
+
+class SampleExporter {
+public:
+    SampleExporter() = default;
+    ~SampleExporter() { cancel(); wait(); }
+
+    // Starts an export in the background. False if one is running or the file cannot be created.
+    bool start(const ExportRequest& request);
+
+    void cancel() { cancelled.store(true); }
+    void wait();
+
+    // Safe to call from any thread
+    ExportProgress progress() const { return status.load(); }
+    bool running() const { return progress().state == ExportState::Running; }
+
+private:
+    struct Buffer {
+        std::vector<char> data;
+        size_t used = 0;
+    };
+
+    void run();
+    void write_rows(const LogSpan& s);
+    void write_header();
+    void put(const char* text, size_t n);
+    bool hand_over();
+    void flush_loop();
+    void publish(ExportState state);
+
+    ExportRequest req;
+    int fd = -1;
+    std::string part_path;
+    int64_t begin_ns = 0;               // Range actually covered by data, for the percentage
+    int64_t end_ns = 0;
+    TimestampFormatter time_format;
+
+    Buffer buffers[2];
+    Buffer* front = nullptr;            // Being filled by the worker
+    Buffer* pending = nullptr;          // Handed to the writer, null once written
+    bool finishing = false;
+    int write_error = 0;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    std::thread worker;
+    std::thread writer;
+    std::atomic<bool> cancelled{ false };
+    ExportProgress counters;            // Worker thread only
+    SeqLock<ExportProgress> status;
+
+    SampleExporter(const SampleExporter&) = delete;
+    SampleExporter& operator=(const SampleExporter&) = delete;
+};
+
+// "<dir>/sensor-YYYYmmdd-HHMMSS.csv" (or ".jsonl") for the current local time
+std::string export_file_name(const std::string& dir, ExportFormat format);
@@ -0,0 +1,253 @@
+﻿#include "sample_kernels.h"
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#elif defined(__aarch64__) && defined(__GNUC__)
+#include <arm_neon.h>
+#define KERNELS_NEON 1
+#endif
+
+void ColumnStats::add(const ColumnStats& o) {
+    ColumnSum::add(o);
+    min = std::min(min, o.min);
+    max = std::max(max, o.max);
+}
+
+namespace {
+    const int LANES = 8;
+
+    // Sample i of a block always goes to lane i % 8, and the lanes are combined in the
+    // same tree, so the vector variants only change how fast the lanes fill up
+    struct Lanes {
+        double sum[LANES] = {};
+        uint64_t count = 0;
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+
+        // fabsf(v) <= FLT_MAX is false for NaN and infinity and compiles to a compare
+        void add(int lane, float v) {
+            if (!(fabsf(v) <= FLT_MAX)) return;
+            sum[lane] += v;
+            ++count;
+            min = std::min(min, v);
+            max = std::max(max, v);
+        }
+
+        void tail(const float* x, size_t i, size_t n) {
+            for (int k = 0; i < n; ++i, ++k) add(k, x[i]);
+        }
+
+        ColumnStats result() const {
+            ColumnStats out;
+            out.sum = ((sum[0] + sum[1]) + (sum[2] + sum[3])) + ((sum[4] + sum[5]) + (sum[6] + sum[7]));
+            out.count = count;
+            out.min = min;
+            out.max = max;
+            return out;
+        }
+    };
+
+    ColumnStats block_scalar(const float* x, size_t n) {
+        Lanes l;
+        size_t i = 0;
+        for (; i + LANES <= n; i += LANES)
+            for (int k = 0; k < LANES; ++k) l.add(k, x[i + k]);
+        l.tail(x, i, n);
+        return l.result();
+    }
+
+#if defined(KERNELS_X86)
+    // SSE2 is part of x86-64: four floats per vector, lanes 0-1, 2-3, 4-5, 6-7 in four __m128d
+    ColumnStats block_sse2(const float* x, size_t n) {
+        const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 limit = _mm_set1_ps(FLT_MAX);
+        const __m128 pos_inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        const __m128 neg_inf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        __m128d s01 = _mm_setzero_pd(), s23 = _mm_setzero_pd(), s45 = _mm_setzero_pd(), s67 = _mm_setzero_pd();
+        __m128 vmin = pos_inf, vmax = neg_inf;
+        __m128i count = _mm_setzero_si128();
+
+        size_t i = 0;
+        for (; i + LANES <= n; i += LANES) {
+            __m128 a = _mm_loadu_ps(x + i);
+            __m128 b = _mm_loadu_ps(x + i + 4);
+            __m128 ma = _mm_cmple_ps(_mm_and_ps(a, abs_mask), limit);
+            __m128 mb = _mm_cmple_ps(_mm_and_ps(b, abs_mask), limit);
+            __m128 fa = _mm_and_ps(a, ma);
+            __m128 fb = _mm_and_ps(b, mb);
+
+            s01 = _mm_add_pd(s01, _mm_cvtps_pd(fa));
+            s23 = _mm_add_pd(s23, _mm_cvtps_pd(_mm_movehl_ps(fa, fa)));
+            s45 = _mm_add_pd(s45, _mm_cvtps_pd(fb));
+            s67 = _mm_add_pd(s67, _mm_cvtps_pd(_mm_movehl_ps(fb, fb)));
+
+            vmin = _mm_min_ps(vmin, _mm_or_ps(fa, _mm_andnot_ps(ma, pos_inf)));
+            vmin = _mm_min_ps(vmin, _mm_or_ps(fb, _mm_andnot_ps(mb, pos_inf)));
+            vmax = _mm_max_ps(vmax, _mm_or_ps(fa, _mm_andnot_ps(ma, neg_inf)));
+            vmax = _mm_max_ps(vmax, _mm_or_ps(fb, _mm_andnot_ps(mb, neg_inf)));
+
+            count = _mm_sub_epi32(count, _mm_castps_si128(ma));     // A true compare is -1
+            count = _mm_sub_epi32(count, _mm_castps_si128(mb));
+        }
+
+        Lanes l;
+        _mm_storeu_pd(l.sum + 0, s01);
+        _mm_storeu_pd(l.sum + 2, s23);
+        _mm_storeu_pd(l.sum + 4, s45);
+        _mm_storeu_pd(l.sum + 6, s67);
+        float mins[4], maxs[4];
+        uint32_t counts[4];
+        _mm_storeu_ps(mins, vmin);
+        _mm_storeu_ps(maxs, vmax);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(counts), count);
+        for (int k = 0; k < 4; ++k) {
+            l.min = std::min(l.min, mins[k]);
+            l.max = std::max(l.max, maxs[k]);
+            l.count += counts[k];
+        }
+        l.tail(x, i, n);
+        return l.result();
+    }
+
+    // Eight floats per vector, lanes 0-3 and 4-7 in two __m256d
+    __attribute__((target("avx2")))
+    ColumnStats block_avx2(const float* x, size_t n) {
+        const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        const __m256 limit = _mm256_set1_ps(FLT_MAX);
+        const __m256 pos_inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+        const __m256 neg_inf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+        __m256d s0123 = _mm256_setzero_pd(), s4567 = _mm256_setzero_pd();
+        __m256 vmin = pos_inf, vmax = neg_inf;
+        __m256i count = _mm256_setzero_si256();
+
+        size_t i = 0;
+        for (; i + LANES <= n; i += LANES) {
+            __m256 a = _mm256_loadu_ps(x + i);
+            __m256 m = _mm256_cmp_ps(_mm256_and_ps(a, abs_mask), limit, _CMP_LE_OQ);
+            __m256 f = _mm256_and_ps(a, m);
+
+            s0123 = _mm256_add_pd(s0123, _mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+            s4567 = _mm256_add_pd(s4567, _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+
+            vmin = _mm256_min_ps(vmin, _mm256_blendv_ps(pos_inf, a, m));
+            vmax = _mm256_max_ps(vmax, _mm256_blendv_ps(neg_inf, a, m));
+            count = _mm256_sub_epi32(count, _mm256_castps_si256(m));
+        }
+
+        Lanes l;
+        _mm256_storeu_pd(l.sum + 0, s0123);
+        _mm256_storeu_pd(l.sum + 4, s4567);
+        float mins[8], maxs[8];
+        uint32_t counts[8];
+        _mm256_storeu_ps(mins, vmin);
+        _mm256_storeu_ps(maxs, vmax);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(counts), count);
+        for (int k = 0; k < 8; ++k) {
+            l.min = std::min(l.min, mins[k]);
+            l.max = std::max(l.max, maxs[k]);
+            l.count += counts[k];
+        }
+        l.tail(x, i, n);
+        return l.result();
+    }
+#elif defined(KERNELS_NEON)
+    // Advanced SIMD is part of AArch64: lanes 0-1, 2-3, 4-5, 6-7 in four float64x2_t
+    ColumnStats block_neon(const float* x, size_t n) {
+        const float32x4_t limit = vdupq_n_f32(FLT_MAX);
+        const float32x4_t pos_inf = vdupq_n_f32(std::numeric_limits<float>::infinity());
+        const float32x4_t neg_inf = vdupq_n_f32(-std::numeric_limits<float>::infinity());
+        float64x2_t s01 = vdupq_n_f64(0.0), s23 = vdupq_n_f64(0.0), s45 = vdupq_n_f64(0.0), s67 = vdupq_n_f64(0.0);
+        float32x4_t vmin = pos_inf, vmax = neg_inf;
+        uint32x4_t count = vdupq_n_u32(0);
+
+        size_t i = 0;
+        for (; i + LANES <= n; i += LANES) {
+            float32x4_t a = vld1q_f32(x + i);
+            float32x4_t b = vld1q_f32(x + i + 4);
+            uint32x4_t ma = vcaleq_f32(a, limit);       // |a| <= FLT_MAX, false for NaN
+            uint32x4_t mb = vcaleq_f32(b, limit);
+            float32x4_t fa = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), ma));
+            float32x4_t fb = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(b), mb));
+
+            s01 = vaddq_f64(s01, vcvt_f64_f32(vget_low_f32(fa)));
+            s23 = vaddq_f64(s23, vcvt_high_f64_f32(fa));
+            s45 = vaddq_f64(s45, vcvt_f64_f32(vget_low_f32(fb)));
+            s67 = vaddq_f64(s67, vcvt_high_f64_f32(fb));
+
+            vmin = vminq_f32(vmin, vbslq_f32(ma, a, pos_inf));
+            vmin = vminq_f32(vmin, vbslq_f32(mb, b, pos_inf));
+            vmax = vmaxq_f32(vmax, vbslq_f32(ma, a, neg_inf));
+            vmax = vmaxq_f32(vmax, vbslq_f32(mb, b, neg_inf));
+
+            count = vsubq_u32(count, ma);       // A true compare is all ones
+            count = vsubq_u32(count, mb);
+        }
+
+        Lanes l;
+        vst1q_f64(l.sum + 0, s01);
+        vst1q_f64(l.sum + 2, s23);
+        vst1q_f64(l.sum + 4, s45);
+        vst1q_f64(l.sum + 6, s67);
+        l.min = vminvq_f32(vmin);
+        l.max = vmaxvq_f32(vmax);
+        l.count = vaddvq_u32(count);
+        l.tail(x, i, n);
+        return l.result();
+    }
+#endif
+
+    using BlockFn = ColumnStats (*)(const float*, size_t);
+
+    struct Kernel {
+        BlockFn fn;
+        const char* name;
+    };
+
+    Kernel select() {
+#if defined(KERNELS_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return { block_avx2, "avx2" };
+        return { block_sse2, "sse2" };
+#elif defined(KERNELS_NEON)
+        return { block_neon, "neon" };
+#else
+        return { block_scalar, "scalar" };
+#endif
+    }
+
+    const Kernel& kernel() {
+        static const Kernel k = select();
+        return k;
+    }
+
+    ColumnStats pairwise(BlockFn block, const float* x, size_t n) {
+        if (n <= COLUMN_SUM_BLOCK) return block(x, n);
+
+        // Split on a lane boundary so every block but the last runs full width
+        size_t half = (n / 2 + LANES - 1) / LANES * LANES;
+        ColumnStats out = pairwise(block, x, half);
+        out.add(pairwise(block, x + half, n - half));
+        return out;
+    }
+}
+
+ColumnStats column_stats(const float* x, size_t n) {
+    return pairwise(kernel().fn, x, n);
+}
+
+ColumnStats column_stats_scalar(const float* x, size_t n) {
+    return pairwise(block_scalar, x, n);
+}
+
+ColumnSum column_sum(const float* x, size_t n) {
+    return column_stats(x, n);
+}
+
+const char* column_kernel_name() {
+    return kernel().name;
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Kernels over one float column of samples (the SoA arrays of LogSpan and SampleWindow).
+// The block loop runs on AVX2 or SSE2 on x86-64, on NEON on AArch64, and in portable C
+// elsewhere; the variant is picked once at run time. Every variant keeps the same eight
+// double-precision lanes in the same order, so they return identical results.
+
+struct ColumnSum {
+    double sum = 0.0;
+    uint64_t count = 0;             // Finite values; NaN and infinity are skipped
+
+    void add(const ColumnSum& o) { sum += o.sum; count += o.count; }
+    double mean() const { return count ? sum / static_cast<double>(count) : 0.0; }
+};
+
+struct ColumnStats : ColumnSum {
+    float min = std::numeric_limits<float>::infinity();     // +inf / -inf while count is 0
+    float max = -std::numeric_limits<float>::infinity();
+
+    void add(const ColumnStats& o);
+};
+
+// Sum, count, min and max of the finite values. The sum is pairwise: blocks of up to
+// COLUMN_SUM_BLOCK values are summed in eight independent lanes and the block sums are
+// combined as a binary tree, so the rounding error grows with log2(n) instead of n.
+#define COLUMN_SUM_BLOCK 256
+
+ColumnStats column_stats(const float* x, size_t n);
+ColumnSum column_sum(const float* x, size_t n);
+
+// column_stats() on the portable block loop, whatever the CPU; the baseline of bench_kernels
+ColumnStats column_stats_scalar(const float* x, size_t n);
+
+// "avx2", "sse2", "neon" or "scalar"
+const char* column_kernel_name();
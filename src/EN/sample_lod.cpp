@@ -0,0 +1,131 @@
+﻿#include "sample_lod.h"
+#include "sample_kernels.h"
+#include "sample_store.h"
+
+#include <math.h>
+#include <algorithm>
+
+static void reset(LodSeries& out, int64_t from_ns, int64_t column_ns, size_t columns) {
+    out.from_ns = from_ns;
+    out.column_ns = column_ns;
+    for (int c = 0; c < 3; ++c) {
+        out.min[c].assign(columns, NAN);
+        out.max[c].assign(columns, NAN);
+        out.lo[c] = out.hi[c] = 0.0f;
+    }
+    out.filled = 0;
+    out.source = -1;
+}
+
+static size_t column_of(const LodSeries& out, int64_t ts_ns) {
+    int64_t col = (ts_ns - out.from_ns) / out.column_ns;
+    return static_cast<size_t>(std::min<int64_t>(std::max<int64_t>(col, 0), out.columns() - 1));
+}
+
+static void fold(LodSeries& out, size_t col, int c, float lo, float hi) {
+    float& mn = out.min[c][col];
+    float& mx = out.max[c][col];
+    mn = isnan(mn) ? lo : std::min(mn, lo);
+    mx = isnan(mx) ? hi : std::max(mx, hi);
+}
+
+// A column belongs to the first pass that puts data into it: later, coarser passes
+// only fill the columns that are still empty
+static bool open_for(const std::vector<uint8_t>& pass, size_t col, uint8_t id) {
+    return pass[col] == 0 || pass[col] == id;
+}
+
+// A bucket wider than a column (a coarser tier standing in for an evicted one) is
+// spread over every column it covers
+static void fill_from_tier(const std::string& dir, RollupTier tier, int64_t to_ns,
+    LodSeries& out, std::vector<uint8_t>& pass, uint8_t id)
+{
+    std::vector<RollupBucket> buckets;
+    if (rollup_buckets(dir, tier, out.from_ns, to_ns, buckets) == 0) return;
+
+    int64_t width = rollup_width_ns(tier);
+    for (const auto& b : buckets) {
+        // rollup_buckets() includes the bucket straddling from_ns; unless it is spread, it
+        // belongs to the column before this range
+        if (width <= out.column_ns && b.start_ns < out.from_ns) continue;
+        size_t first = column_of(out, b.start_ns);
+        size_t last = width > out.column_ns ? column_of(out, std::min(b.start_ns + width, to_ns) - 1) : first;
+        for (size_t col = first; col <= last; ++col) {
+            if (!open_for(pass, col, id)) continue;
+            for (int c = 0; c < 3; ++c)
+                if (b.count[c]) fold(out, col, c, b.min[c], b.max[c]);
+            pass[col] = id;
+        }
+        if (out.source < 0 || static_cast<int>(tier) < out.source) out.source = static_cast<int>(tier);
+    }
+}
+
+// Runs of samples that fall into the same column go through the column kernels at once
+static void fill_from_log(const std::string& dir, int64_t to_ns, LodSeries& out,
+    std::vector<uint8_t>& pass, uint8_t id)
+{
+    int64_t from_ns = out.from_ns;
+    store_for_range(dir, from_ns, to_ns, [&](const LogSpan& s) {
+        const float* columns[3] = { s.temp, s.cond, s.pres };
+        size_t i = 0;
+        while (i < s.count && s.ts(i) < from_ns) ++i;
+        while (i < s.count && s.ts(i) < to_ns) {
+            size_t col = column_of(out, s.ts(i));
+            int64_t col_end = (col + 1 == out.columns()) ? to_ns : out.from_ns + static_cast<int64_t>(col + 1) * out.column_ns;
+            size_t j = i + 1;
+            while (j < s.count && s.ts(j) < col_end) ++j;
+
+            if (open_for(pass, col, id)) {
+                for (int c = 0; c < 3; ++c) {
+                    ColumnStats st = column_stats(columns[c] + i, j - i);
+                    if (st.count) fold(out, col, c, st.min, st.max);
+                }
+                pass[col] = id;
+                out.source = -1;
+            }
+            i = j;
+        }
+    });
+}
+
+size_t lod_query(const std::string& dir, int64_t from_ns, int64_t to_ns, size_t columns, LodSeries& out) {
+    columns = std::max<size_t>(columns, 1);
+    int64_t column_ns = std::max<int64_t>((to_ns - from_ns) / static_cast<int64_t>(columns), 1);
+    reset(out, from_ns, column_ns, columns);
+    if (to_ns <= from_ns) return 0;
+
+    std::vector<uint8_t> pass(columns, 0);
+    uint8_t id = 0;
+    if (column_ns < rollup_width_ns(RollupTier::Second)) {
+        fill_from_log(dir, to_ns, out, pass, ++id);
+    }
+    else {
+        int finest = 0;
+        while (finest + 1 < ROLLUP_TIERS && rollup_width_ns(static_cast<RollupTier>(finest + 1)) <= column_ns)
+            ++finest;
+
+        for (int t = finest; t < ROLLUP_TIERS; ++t) {
+            fill_from_tier(dir, static_cast<RollupTier>(t), to_ns, out, pass, ++id);
+
+            // Sub-minute columns older than the second tier's six hours come from the raw
+            // segments if they are still there. Empty columns inside the retained part are
+            // simply empty (no samples, or the future) and never send the query to the log.
+            if (t == static_cast<int>(RollupTier::Second)) {
+                int64_t retained_ns = rollup_retained_from_ns(dir, RollupTier::Second);
+                if (from_ns < retained_ns) fill_from_log(dir, std::min(to_ns, retained_ns), out, pass, ++id);
+            }
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        ColumnStats lo = column_stats(out.min[c].data(), columns);
+        ColumnStats hi = column_stats(out.max[c].data(), columns);
+        if (lo.count) {
+            out.lo[c] = lo.min;
+            out.hi[c] = hi.max;
+        }
+    }
+    for (size_t col = 0; col < columns; ++col)
+        if (pass[col] != 0) ++out.filled;
+    return out.filled;
+}
@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include "sample_rollup.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Level-of-detail reduction of a time range to a fixed number of chart columns
+// (one per pixel), keeping the min and max of every column so peaks survive.
+//
+// The rollup tiers are the precomputed pyramid: each column is filled from the coarsest
+// tier whose buckets are no wider than the column (hour, minute or second), so a year
+// costs the 8760 hour buckets and never the raw samples. Ranges finer than one second per
+// column read the raw segments, as do sub-minute columns older than the second tier's
+// retention; empty columns inside it stay empty and never cause a raw scan. Columns no
+// source at that resolution covers are filled from the next coarser tier.
+
+struct LodSeries {
+    int64_t from_ns = 0;
+    int64_t column_ns = 0;
+    std::vector<float> min[3];      // Per channel and column, NaN where a column has no data
+    std::vector<float> max[3];
+    float lo[3] = {};               // Extremes of the whole range, for autoscaling
+    float hi[3] = {};
+    size_t filled = 0;              // Columns with data
+    int source = -1;                // Finest source used: a RollupTier, or -1 for raw samples
+
+    size_t columns() const { return min[0].size(); }
+};
+
+// Fills `out` for [from_ns, to_ns) in `columns` columns. Returns the number of columns with data.
+size_t lod_query(const std::string& dir, int64_t from_ns, int64_t to_ns, size_t columns, LodSeries& out);
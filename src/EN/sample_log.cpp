@@ -0,0 +1,520 @@
+﻿#include "sample_log.h"
+#include "sample_codec.h"
+#include "crc32c.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef SAMPLE_LOG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static bool has_suffix(const std::string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    return s.size() > n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+std::string sample_log_index_path(const std::string& log_path) {
+    std::string base = log_path;
+    if (has_suffix(base, ".gz"))
+        base.resize(base.size() - 3);
+    else if (has_suffix(base, SAMPLE_CODEC_SUFFIX))
+        base.resize(base.size() - strlen(SAMPLE_CODEC_SUFFIX));
+    return base + SAMPLE_LOG_INDEX_SUFFIX;
+}
+
+static uint32_t block_capacity(uint16_t version) {
+    return version == 1 ? SAMPLE_LOG_V1_CAPACITY : version == SAMPLE_LOG_VERSION ? SAMPLE_LOG_CAPACITY : 0;
+}
+
+bool log_header_valid(const LogBlockHeader& h) {
+    uint32_t capacity = block_capacity(h.version);
+    return h.magic == SAMPLE_LOG_MAGIC && h.header_size == SAMPLE_LOG_HEADER &&
+        capacity != 0 && h.capacity == capacity && h.count <= capacity;
+}
+
+// The chain starts from the block's start time, so records left over from another block never verify
+uint32_t log_chain_seed(const LogBlockHeader& h) {
+    return crc32c(0, &h.first_ts_ns, sizeof(h.first_ts_ns));
+}
+
+uint32_t log_record_crc(uint32_t prev, const LogBlock& b, uint32_t i) {
+    uint32_t record[4];
+    record[0] = b.dt_us[i];
+    memcpy(&record[1], &b.temp[i], sizeof(float));
+    memcpy(&record[2], &b.cond[i], sizeof(float));
+    memcpy(&record[3], &b.pres[i], sizeof(float));
+    return crc32c(prev, record, sizeof(record));
+}
+
+void append_span(const LogSpan& s, SampleWindow& out) {
+    for (size_t i = 0; i < s.count; ++i)
+        out.ts.push_back(s.ts(i));
+    out.temp.insert(out.temp.end(), s.temp, s.temp + s.count);
+    out.cond.insert(out.cond.end(), s.cond, s.cond + s.count);
+    out.pres.insert(out.pres.end(), s.pres, s.pres + s.count);
+}
+
+#ifndef _WIN32
+
+// Largest offset a block can hold, about 71 minutes
+static const int64_t MAX_BLOCK_SPAN_NS = 0xFFFFFFFFLL * 1000;
+
+// Invalid blocks dropped from the end of the log at most; anything further back is left to readers
+static const uint64_t MAX_RECOVERY_BLOCKS = 16;
+
+static uint32_t header_crc(const LogBlockHeader& h) {
+    return crc32c(0, &h, offsetof(LogBlockHeader, header_crc));
+}
+
+// Structure plus checksum; version 1 blocks have no checksum to verify
+static bool intact_header(const LogBlockHeader& h) {
+    return log_header_valid(h) && (h.version == 1 || h.header_crc == header_crc(h));
+}
+
+static void account(LogBlockHeader& h, const float values[3]) {
+    for (int c = 0; c < 3; ++c) {
+        if (!std::isfinite(values[c])) continue;
+        if (h.valid[c] == 0 || values[c] < h.min[c]) h.min[c] = values[c];
+        if (h.valid[c] == 0 || values[c] > h.max[c]) h.max[c] = values[c];
+        h.sum[c] += values[c];
+        ++h.valid[c];
+    }
+}
+
+bool SampleLogWriter::open(const char* path, LogDurability mode) {
+    close();
+
+    durability = mode;
+    fd = ::open(path, O_RDWR | O_CREAT | (mode == LogDurability::Dsync ? O_DSYNC : 0), 0644);
+    if (fd < 0) {
+        perror("Failed to open sample log");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("Failed to stat sample log");
+        close();
+        return false;
+    }
+
+    // A partial block at the end is left over from an interrupted write
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    uint64_t blocks = recover_tail(size / SAMPLE_LOG_BLOCK);
+    if (blocks * SAMPLE_LOG_BLOCK != size && ftruncate(fd, static_cast<off_t>(blocks * SAMPLE_LOG_BLOCK)) != 0)
+        perror("Failed to trim sample log");
+
+    // recover_tail() leaves the last block loaded; only a current-version block with room is resumed
+    block_index = blocks;
+    dirty = false;
+    if (blocks > 0 && block.header.version == SAMPLE_LOG_VERSION && block.header.count < SAMPLE_LOG_CAPACITY)
+        block_index = blocks - 1;
+    else
+        memset(&block, 0, sizeof(block));
+
+    // The index is only a cache of the block headers; without it queries fall back to a scan
+    index_fd = ::open(sample_log_index_path(path).c_str(), O_RDWR | O_CREAT, 0644);
+    if (index_fd < 0)
+        perror("Failed to open sample log index");
+    else
+        sync_index(block_index);
+    return true;
+}
+
+// Drops torn blocks from the end of the log and cuts the last one back to its last
+// record whose checksum chain verifies. Records past the header's count that verify
+// were written before the header and are kept. Only the tail is read, so the cost
+// does not depend on the size of the log. Returns the number of blocks to keep.
+uint64_t SampleLogWriter::recover_tail(uint64_t blocks) {
+    memset(&block, 0, sizeof(block));
+
+    uint64_t dropped = 0;
+    while (blocks > 0) {
+        bool read = pread(fd, &block, sizeof(block), static_cast<off_t>((blocks - 1) * SAMPLE_LOG_BLOCK))
+            == static_cast<ssize_t>(sizeof(block));
+        if (read && intact_header(block.header)) break;
+        if (dropped == MAX_RECOVERY_BLOCKS) {
+            memset(&block, 0, sizeof(block));
+            return blocks;          // Not a torn tail; new blocks go after it
+        }
+        --blocks;
+        ++dropped;
+    }
+    if (blocks == 0) {
+        memset(&block, 0, sizeof(block));
+        return 0;
+    }
+
+    LogBlockHeader& h = block.header;
+    if (h.version == SAMPLE_LOG_VERSION) {
+        uint32_t crc = log_chain_seed(h);
+        uint32_t n = 0;
+        while (n < SAMPLE_LOG_CAPACITY && log_record_crc(crc, block, n) == block.crc[n])
+            crc = block.crc[n++];
+
+        if (n != h.count) {
+            fprintf(stderr, "Sample log: block %llu recovered with %u of %u samples\n",
+                static_cast<unsigned long long>(blocks - 1), n, h.count);
+
+            // Summary rebuilt from the records that verified
+            memset(h.min, 0, sizeof(h.min));
+            memset(h.max, 0, sizeof(h.max));
+            memset(h.sum, 0, sizeof(h.sum));
+            memset(h.valid, 0, sizeof(h.valid));
+            for (uint32_t i = 0; i < n; ++i) {
+                const float values[3] = { block.temp[i], block.cond[i], block.pres[i] };
+                account(h, values);
+            }
+            h.count = n;
+            h.last_ts_ns = n > 0 ? h.first_ts_ns + static_cast<int64_t>(block.dt_us[n - 1]) * 1000 : h.first_ts_ns;
+
+            if (n == 0) {
+                ++dropped;
+                --blocks;
+                memset(&block, 0, sizeof(block));
+            }
+            else {
+                block_index = blocks - 1;
+                write_block();
+            }
+        }
+    }
+    if (dropped > 0)
+        fprintf(stderr, "Sample log: dropped %llu torn block(s) at the end\n", static_cast<unsigned long long>(dropped));
+    return blocks;
+}
+
+void SampleLogWriter::close() {
+    if (fd >= 0) commit();
+    if (fd >= 0) ::close(fd);
+    if (index_fd >= 0) ::close(index_fd);
+    fd = -1;
+    index_fd = -1;
+}
+
+void SampleLogWriter::seal() {
+    if (fd >= 0 && block.header.count > 0 && commit())
+        index_block(block_index, block.header);
+}
+
+void SampleLogWriter::index_block(uint64_t index, const LogBlockHeader& h) {
+    LogIndexEntry e = {};
+    if (log_header_valid(h) && h.count > 0) {
+        e.first_ts_ns = h.first_ts_ns;
+        e.last_ts_ns = h.last_ts_ns;
+        e.count = h.count;
+        index_max_ts = std::max(index_max_ts, h.last_ts_ns);
+    }
+    e.max_ts_ns = index_max_ts;
+
+    if (index_fd >= 0 &&
+        pwrite(index_fd, &e, sizeof(e), static_cast<off_t>(index * sizeof(e))) != static_cast<ssize_t>(sizeof(e)))
+        perror("Failed to write sample log index");
+}
+
+// Brings the index up to the sealed blocks: entries that still match their block are kept,
+// anything else (missing, stale after a crash, foreign file) is rebuilt from the headers
+void SampleLogWriter::sync_index(uint64_t sealed) {
+    struct stat st;
+    uint64_t entries = fstat(index_fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) / sizeof(LogIndexEntry) : 0;
+    if (entries > sealed) entries = sealed;     // The resumed block was indexed by seal()
+
+    LogBlockHeader h;
+    LogIndexEntry e;
+    if (entries > 0) {
+        bool match =
+            pread(index_fd, &e, sizeof(e), static_cast<off_t>((entries - 1) * sizeof(e))) == static_cast<ssize_t>(sizeof(e)) &&
+            pread(fd, &h, sizeof(h), static_cast<off_t>((entries - 1) * SAMPLE_LOG_BLOCK)) == static_cast<ssize_t>(sizeof(h)) &&
+            log_header_valid(h) && e.first_ts_ns == h.first_ts_ns && e.count == h.count;
+        if (match)
+            index_max_ts = e.max_ts_ns;
+        else
+            entries = 0;
+    }
+    if (entries == 0) index_max_ts = INT64_MIN;
+
+    for (uint64_t i = entries; i < sealed; ++i) {
+        if (pread(fd, &h, sizeof(h), static_cast<off_t>(i * SAMPLE_LOG_BLOCK)) != static_cast<ssize_t>(sizeof(h)))
+            memset(&h, 0, sizeof(h));
+        index_block(i, h);
+    }
+    if (ftruncate(index_fd, static_cast<off_t>(sealed * sizeof(LogIndexEntry))) != 0)
+        perror("Failed to trim sample log index");
+}
+
+bool SampleLogWriter::start_block(int64_t realtime_ns) {
+    if (block.header.count > 0) {
+        if (dirty && !write_block()) return false;
+        index_block(block_index, block.header);     // Sealed, it is never written again
+        ++block_index;
+    }
+    memset(&block, 0, sizeof(block));
+
+    LogBlockHeader& h = block.header;
+    h.magic = SAMPLE_LOG_MAGIC;
+    h.version = SAMPLE_LOG_VERSION;
+    h.header_size = SAMPLE_LOG_HEADER;
+    h.capacity = SAMPLE_LOG_CAPACITY;
+    h.first_ts_ns = realtime_ns;
+    h.last_ts_ns = realtime_ns;
+    return true;
+}
+
+bool SampleLogWriter::add(int64_t realtime_ns, const sensor_data_t& data) {
+    if (fd < 0) return false;
+
+    // A new block starts when this one is full, or the offset does not fit (clock set back, long gap)
+    LogBlockHeader& h = block.header;
+    if (h.count == 0 || h.count >= SAMPLE_LOG_CAPACITY ||
+        realtime_ns < h.first_ts_ns || realtime_ns - h.first_ts_ns > MAX_BLOCK_SPAN_NS) {
+        if (!start_block(realtime_ns)) return false;
+    }
+
+    uint32_t i = h.count;
+    block.dt_us[i] = static_cast<uint32_t>((realtime_ns - h.first_ts_ns) / 1000);
+    block.temp[i] = data.value1;
+    block.cond[i] = data.value2;
+    block.pres[i] = data.value3;
+    block.crc[i] = log_record_crc(i > 0 ? block.crc[i - 1] : log_chain_seed(h), block, i);
+
+    const float values[3] = { data.value1, data.value2, data.value3 };
+    account(h, values);
+    h.last_ts_ns = realtime_ns;
+    ++h.count;
+    dirty = true;
+    return true;
+}
+
+bool SampleLogWriter::write_block() {
+    // Columns first, then the header that makes the new samples visible to mapped readers
+    block.header.header_crc = header_crc(block.header);
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&block);
+    off_t offset = static_cast<off_t>(block_index * SAMPLE_LOG_BLOCK);
+    if (pwrite(fd, bytes + SAMPLE_LOG_HEADER, SAMPLE_LOG_BLOCK - SAMPLE_LOG_HEADER, offset + SAMPLE_LOG_HEADER)
+            != SAMPLE_LOG_BLOCK - SAMPLE_LOG_HEADER ||
+        pwrite(fd, bytes, SAMPLE_LOG_HEADER, offset) != SAMPLE_LOG_HEADER) {
+        perror("Failed to write sample log");
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+bool SampleLogWriter::commit() {
+    if (fd < 0) return false;
+    if (!dirty) return true;
+    if (!write_block()) return false;
+
+    if (durability == LogDurability::Fdatasync && fdatasync(fd) != 0) {
+        perror("Failed to sync sample log");
+        return false;
+    }
+    return true;
+}
+
+bool SampleLogView::open(const char* path) {
+    close();
+    index_fd = ::open(sample_log_index_path(path).c_str(), O_RDONLY);
+
+    if (has_suffix(path, ".gz") || has_suffix(path, SAMPLE_CODEC_SUFFIX)) {
+        if (inflate(path)) return true;
+        close();
+        return false;
+    }
+
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        close();
+        return false;
+    }
+    if (!refresh()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SampleLogView::close() {
+    if (base && inflated.empty()) munmap(const_cast<uint8_t*>(base), mapped);
+    inflated.clear();
+    inflated.shrink_to_fit();
+    if (index) munmap(const_cast<LogIndexEntry*>(index), index_mapped);
+    if (fd >= 0) ::close(fd);
+    if (index_fd >= 0) ::close(index_fd);
+    base = nullptr;
+    mapped = 0;
+    blocks = 0;
+    fd = -1;
+    index = nullptr;
+    index_mapped = 0;
+    index_entries = 0;
+    index_fd = -1;
+}
+
+bool SampleLogView::map_index() {
+    if (index) munmap(const_cast<LogIndexEntry*>(index), index_mapped);
+    index = nullptr;
+    index_mapped = 0;
+    index_entries = 0;
+
+    struct stat st;
+    if (index_fd < 0 || fstat(index_fd, &st) != 0) return false;
+    size_t size = static_cast<size_t>(st.st_size) / sizeof(LogIndexEntry) * sizeof(LogIndexEntry);
+    if (size == 0) return false;
+
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, index_fd, 0);
+    if (p == MAP_FAILED) return false;
+
+    index = static_cast<const LogIndexEntry*>(p);
+    index_mapped = size;
+    index_entries = std::min(size / sizeof(LogIndexEntry), blocks);
+    return true;
+}
+
+size_t SampleLogView::first_block_since(int64_t since_ns) const {
+    // max_ts_ns never decreases, so every block before the first entry reaching since_ns ends earlier
+    const LogIndexEntry* end = index + index_entries;
+    const LogIndexEntry* it = std::lower_bound(index, end, since_ns,
+        [](const LogIndexEntry& e, int64_t ts) { return e.max_ts_ns < ts; });
+    return static_cast<size_t>(it - index);
+}
+
+// Compressed segments are closed, so they are read once into memory and never refreshed
+bool SampleLogView::inflate(const char* path) {
+    bool ok = false;
+    if (has_suffix(path, SAMPLE_CODEC_SUFFIX)) {
+        // Decoded a block at a time; a damaged frame ends the segment there
+        GorillaReader reader;
+        uint8_t block[SAMPLE_LOG_BLOCK];
+        ok = reader.open(path);
+        while (ok && reader.next(block))
+            inflated.insert(inflated.end(), block, block + SAMPLE_LOG_BLOCK);
+    }
+    else {
+#ifdef SAMPLE_LOG_HAVE_ZLIB
+        gzFile gz = gzopen(path, "rb");
+        if (!gz) return false;
+
+        uint8_t chunk[64 * 1024];
+        int n;
+        while ((n = gzread(gz, chunk, sizeof(chunk))) > 0)
+            inflated.insert(inflated.end(), chunk, chunk + n);
+        ok = n == 0;
+        gzclose(gz);
+#else
+        fprintf(stderr, "Compressed sample log segments need zlib\n");
+        return false;
+#endif
+    }
+
+    size_t size = inflated.size() / SAMPLE_LOG_BLOCK * SAMPLE_LOG_BLOCK;
+    if (!ok || size == 0) {
+        inflated.clear();
+        return false;
+    }
+    base = inflated.data();
+    mapped = size;
+    blocks = size / SAMPLE_LOG_BLOCK;
+    map_index();
+    return true;
+}
+
+bool SampleLogView::refresh() {
+    if (fd < 0) return !inflated.empty();
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    size_t size = static_cast<size_t>(st.st_size) / SAMPLE_LOG_BLOCK * SAMPLE_LOG_BLOCK;
+    if (size == mapped) return base != nullptr || size == 0;
+
+    if (base) munmap(const_cast<uint8_t*>(base), mapped);
+    base = nullptr;
+    mapped = 0;
+    blocks = 0;
+    if (size == 0) return true;
+
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("Failed to map sample log");
+        return false;
+    }
+    madvise(p, size, MADV_SEQUENTIAL);
+
+    base = static_cast<const uint8_t*>(p);
+    mapped = size;
+    blocks = size / SAMPLE_LOG_BLOCK;
+    map_index();
+    return true;
+}
+
+LogSpan SampleLogView::span(size_t index) const {
+    LogSpan s;
+    if (index >= blocks) return s;
+
+    const uint8_t* b = base + index * SAMPLE_LOG_BLOCK;
+    const LogBlockHeader* h = reinterpret_cast<const LogBlockHeader*>(b);
+    if (!log_header_valid(*h)) return s;
+
+    // The writer may be rewriting the header of the last block, which is checked on open instead
+    bool open_block = fd >= 0 && index + 1 == blocks;
+    if (!open_block && !intact_header(*h)) return s;
+
+    const uint8_t* columns = b + SAMPLE_LOG_HEADER;
+    s.header = h;
+    s.dt_us = reinterpret_cast<const uint32_t*>(columns);
+    s.temp = reinterpret_cast<const float*>(columns + 4 * h->capacity);
+    s.cond = reinterpret_cast<const float*>(columns + 8 * h->capacity);
+    s.pres = reinterpret_cast<const float*>(columns + 12 * h->capacity);
+    s.count = h->count;
+    return s;
+}
+
+size_t read_sample_log_since(const char* path, int64_t since_ns, SampleWindow& out) {
+    out.clear();
+    SampleLogView view;
+    if (!view.open(path)) return 0;
+    view.for_since(since_ns, [&out](const LogSpan& s) { append_span(s, out); });
+    return out.size();
+}
+
+size_t read_sample_log_last(const char* path, size_t count, SampleWindow& out) {
+    out.clear();
+    SampleLogView view;
+    if (!view.open(path)) return 0;
+    view.for_last(count, [&out](const LogSpan& s) { append_span(s, out); });
+    return out.size();
+}
+
+#else
+
+// The Windows simulator has no log file
+bool SampleLogWriter::open(const char*, LogDurability) { return false; }
+uint64_t SampleLogWriter::recover_tail(uint64_t) { return 0; }
+void SampleLogWriter::close() {}
+bool SampleLogWriter::start_block(int64_t) { return false; }
+bool SampleLogWriter::write_block() { return false; }
+void SampleLogWriter::seal() {}
+bool SampleLogWriter::commit() { return false; }
+bool SampleLogWriter::add(int64_t, const sensor_data_t&) { return false; }
+bool SampleLogView::open(const char*) { return false; }
+void SampleLogView::close() {}
+bool SampleLogView::refresh() { return false; }
+bool SampleLogView::map_index() { return false; }
+bool SampleLogView::inflate(const char*) { return false; }
+size_t SampleLogView::first_block_since(int64_t) const { return 0; }
+LogSpan SampleLogView::span(size_t) const { return LogSpan(); }
+size_t read_sample_log_since(const char*, int64_t, SampleWindow& out) { out.clear(); return 0; }
+size_t read_sample_log_last(const char*, size_t, SampleWindow& out) { out.clear(); return 0; }
+
+#endif
@@ -0,0 +1,246 @@
+﻿#pragma once
+
+#include "serial_sensor.h"
+#include "sample_ring.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <string>
+#include <vector>
+
+#define SAMPLE_LOG_PATH "/etc/sensor_data.bin"   // Single-file log of earlier versions, now a SampleStore segment
+#define SAMPLE_LOG_INDEX_SUFFIX ".idx"
+
+// Binary sample log, replacing the old "YYYY-mm-dd HH:MM:SS, Temp: ..." text lines.
+//
+// The file is a sequence of 4 KiB blocks. Each block has a header with its own
+// summary (time range, per-channel min/max/sum) followed by one column per field,
+// so a reader can skip or aggregate whole blocks on the header alone and read a
+// channel as a plain float array. A sample costs 20 bytes instead of ~72 as text.
+//
+// Version 2 adds crash consistency: every record carries a CRC-32C chained from the
+// previous one (the first is seeded with the block's start time) and the header has
+// its own CRC. When the writer opens the log it checks only the last blocks and cuts
+// them back to the last record whose chain verifies, so a torn write after a power
+// loss costs the unfinished records, never the file. Version 1 blocks (no CRC column,
+// 248 samples) are still read.
+
+#define SAMPLE_LOG_MAGIC    0x474F4C53u     // "SLOG"
+#define SAMPLE_LOG_VERSION  2
+#define SAMPLE_LOG_BLOCK    4096
+#define SAMPLE_LOG_HEADER   128
+#define SAMPLE_LOG_RECORD   20              // dt_us, temp, cond, pres, crc
+#define SAMPLE_LOG_CAPACITY ((SAMPLE_LOG_BLOCK - SAMPLE_LOG_HEADER) / SAMPLE_LOG_RECORD)   // 198 samples
+#define SAMPLE_LOG_V1_CAPACITY ((SAMPLE_LOG_BLOCK - SAMPLE_LOG_HEADER) / 16)             // 248 samples
+
+struct LogBlockHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t count;             // Samples in use; the last block of the file may be partly filled
+    uint32_t capacity;
+    int64_t  first_ts_ns;       // Wall clock (CLOCK_REALTIME) nanoseconds
+    int64_t  last_ts_ns;
+    float    min[3];            // Temperature, conductivity, pressure; finite values only
+    float    max[3];
+    double   sum[3];
+    uint32_t valid[3];          // Finite values per channel, the divisor for sum
+    uint8_t  reserved[32];
+    uint32_t header_crc;        // CRC-32C of the bytes above (version 2)
+};
+
+// Columns start right after the header, each `capacity` entries long, so version 1
+// blocks share the layout up to the missing crc column.
+struct LogBlock {
+    LogBlockHeader header;
+    uint32_t dt_us[SAMPLE_LOG_CAPACITY];    // Offset from first_ts_ns in microseconds
+    float temp[SAMPLE_LOG_CAPACITY];
+    float cond[SAMPLE_LOG_CAPACITY];
+    float pres[SAMPLE_LOG_CAPACITY];
+    uint32_t crc[SAMPLE_LOG_CAPACITY];      // CRC-32C of this record, continuing the previous one
+    uint8_t reserved[SAMPLE_LOG_BLOCK - SAMPLE_LOG_HEADER - SAMPLE_LOG_CAPACITY * SAMPLE_LOG_RECORD];
+};
+
+// Sidecar time index ("<log>.idx"), one entry per sealed block, so a time range query
+// binary-searches a small dense array instead of touching every block of the log.
+// The open (last) block is not indexed; readers check it on its header.
+struct LogIndexEntry {
+    int64_t first_ts_ns;
+    int64_t last_ts_ns;
+    int64_t max_ts_ns;          // Largest last_ts_ns up to this block; never decreases, even if the clock was set back
+    uint32_t count;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(LogBlockHeader) == SAMPLE_LOG_HEADER, "log block header size");
+static_assert(sizeof(LogBlock) == SAMPLE_LOG_BLOCK, "log block size");
+static_assert(sizeof(LogIndexEntry) == 32, "log index entry size");
+
+// Structure check of a block header (magic, version, capacity, count)
+bool log_header_valid(const LogBlockHeader& h);
+
+// CRC chain of version 2 records (LogBlock::crc); rebuilt when a compressed segment is decoded
+uint32_t log_chain_seed(const LogBlockHeader& h);
+uint32_t log_record_crc(uint32_t prev, const LogBlock& b, uint32_t i);
+
+// How far a commit goes before it returns
+enum class LogDurability {
+    None,           // Page cache only, the kernel writes back on its own schedule
+    Fdatasync,      // fdatasync() after every commit (one flash flush per batch)
+    Dsync           // File opened with O_DSYNC, every block write reaches the device
+};
+
+// Appends to the log from a single thread. Samples are buffered in the open block;
+// commit() writes its columns and then its header, so a reader never sees a count
+// ahead of the data. A block that fills up is written when the next one starts.
+class SampleLogWriter {
+public:
+    SampleLogWriter() = default;
+    ~SampleLogWriter() { close(); }
+
+    // Opens or creates the log, repairs a torn tail and resumes its last block if it is not full
+    bool open(const char* path, LogDurability durability = LogDurability::None);
+    void close();                   // Commits what is still buffered
+    bool is_open() const { return fd >= 0; }
+
+    bool add(int64_t realtime_ns, const sensor_data_t& data);
+    bool commit();
+    bool append(int64_t realtime_ns, const sensor_data_t& data) { return add(realtime_ns, data) && commit(); }
+
+    // Indexes the open block as well; called when the file is closed for good (segment rollover)
+    void seal();
+
+    uint64_t blocks_used() const { return block_index + (block.header.count > 0 ? 1 : 0); }
+    bool block_full() const { return block.header.count >= SAMPLE_LOG_CAPACITY; }
+
+private:
+    uint64_t recover_tail(uint64_t blocks);
+    bool start_block(int64_t realtime_ns);
+    bool write_block();
+    void sync_index(uint64_t sealed);
+    void index_block(uint64_t index, const LogBlockHeader& h);
+
+    int fd = -1;
+    LogDurability durability = LogDurability::None;
+    uint64_t block_index = 0;
+    LogBlock block;
+    bool dirty = false;             // Samples added since the last write of the open block
+
+    int index_fd = -1;
+    int64_t index_max_ts = INT64_MIN;
+
+    SampleLogWriter(const SampleLogWriter&) = delete;
+    SampleLogWriter& operator=(const SampleLogWriter&) = delete;
+};
+
+// Run of samples inside one mapped block. The pointers stay valid while the view is open.
+struct LogSpan {
+    const LogBlockHeader* header = nullptr;
+    const uint32_t* dt_us = nullptr;
+    const float* temp = nullptr;
+    const float* cond = nullptr;
+    const float* pres = nullptr;
+    size_t count = 0;
+
+    int64_t ts(size_t i) const { return header->first_ts_ns + static_cast<int64_t>(dt_us[i]) * 1000; }
+};
+
+// Read-only mmap of the log. Samples are handed out as spans into the mapping, so a
+// query allocates nothing per sample; "last N" is a walk over block headers from the end.
+class SampleLogView {
+public:
+    SampleLogView() = default;
+    ~SampleLogView() { close(); }
+
+    // Maps a log file; a compressed segment ("*.gz", "*.gor") is decoded into memory instead
+    bool open(const char* path);
+    void close();
+    bool is_open() const { return base != nullptr; }
+
+    // Maps blocks appended since open(). Returns false if the file could not be remapped.
+    bool refresh();
+
+    size_t block_count() const { return blocks; }
+    LogSpan span(size_t block) const;       // Empty span for a block that is not valid
+
+    // Calls f(const LogSpan&) for the newest `count` samples, oldest first. Returns the number visited.
+    template <typename F>
+    size_t for_last(size_t count, F f) const {
+        // Spans are taken once, so a block the writer is appending to is seen with one count
+        std::vector<LogSpan> tail;
+        size_t found = 0;
+        for (size_t index = blocks; index > 0 && found < count;) {
+            LogSpan s = span(--index);
+            if (s.count == 0) continue;
+            if (found + s.count > count) s = sub_span(s, s.count - (count - found), s.count);
+            found += s.count;
+            tail.push_back(s);
+        }
+        for (auto it = tail.rbegin(); it != tail.rend(); ++it)
+            f(*it);
+        return found;
+    }
+
+    // First block that can hold a sample at or after since_ns, by binary search on the index
+    size_t first_block_since(int64_t since_ns) const;
+
+    // Calls f(const LogSpan&) for every sample with a wall-clock stamp >= since_ns
+    template <typename F>
+    size_t for_since(int64_t since_ns, F f) const {
+        size_t visited = 0;
+        for (size_t index = first_block_since(since_ns); index < blocks; ++index) {
+            LogSpan s = span(index);
+            if (s.count == 0 || s.header->last_ts_ns < since_ns) continue;
+
+            size_t first = 0;
+            while (first < s.count && s.ts(first) < since_ns) ++first;
+            s = sub_span(s, first, s.count);
+            visited += s.count;
+            f(s);
+        }
+        return visited;
+    }
+
+private:
+    static LogSpan sub_span(const LogSpan& s, size_t first, size_t end) {
+        LogSpan r = s;
+        r.dt_us += first;
+        r.temp += first;
+        r.cond += first;
+        r.pres += first;
+        r.count = end - first;
+        return r;
+    }
+
+    bool map_index();
+
+    bool inflate(const char* path);
+
+    int fd = -1;
+    const uint8_t* base = nullptr;
+    size_t mapped = 0;
+    size_t blocks = 0;
+    std::vector<uint8_t> inflated;      // Backing store of a compressed segment
+
+    int index_fd = -1;
+    const LogIndexEntry* index = nullptr;
+    size_t index_mapped = 0;
+    size_t index_entries = 0;
+
+    SampleLogView(const SampleLogView&) = delete;
+    SampleLogView& operator=(const SampleLogView&) = delete;
+};
+
+// "<log>.idx" for both "<log>" and its compressed forms "<log>.gz" and "<log>.gor"
+std::string sample_log_index_path(const std::string& log_path);
+
+// Copies a span to the end of a window
+void append_span(const LogSpan& s, SampleWindow& out);
+
+// Samples with a wall-clock stamp >= since_ns. Blocks that end earlier are skipped
+// on their header. Returns the number of samples; out.ts holds CLOCK_REALTIME ns.
+size_t read_sample_log_since(const char* path, int64_t since_ns, SampleWindow& out);
+
+// The newest `count` samples (fewer if the log is shorter), oldest first
+size_t read_sample_log_last(const char* path, size_t count, SampleWindow& out);
@@ -0,0 +1,109 @@
+﻿#include "sample_ring.h"
+
+#include <algorithm>
+
+// 2^16 samples: about 18 hours at 1 Hz, 1.3 MB
+static const size_t RECORDER_RING_CAPACITY = 1u << 16;
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+SampleRing::SampleRing(size_t capacity_pow2)
+    : mask(round_up_pow2(std::max<size_t>(capacity_pow2, 2)) - 1),
+      ts(new std::atomic<int64_t>[mask + 1]),
+      temp(new std::atomic<float>[mask + 1]),
+      cond(new std::atomic<float>[mask + 1]),
+      pres(new std::atomic<float>[mask + 1]) {
+}
+
+void SampleRing::push(int64_t ts_ns, const sensor_data_t& data) {
+    uint64_t n = head.load(std::memory_order_relaxed);
+
+    // Announce the overwrite of sample n - capacity before touching its slot
+    claimed.store(n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t i = n & mask;
+    ts[i].store(ts_ns, std::memory_order_relaxed);
+    temp[i].store(data.value1, std::memory_order_relaxed);
+    cond[i].store(data.value2, std::memory_order_relaxed);
+    pres[i].store(data.value3, std::memory_order_relaxed);
+
+    head.store(n + 1, std::memory_order_release);
+}
+
+size_t SampleRing::size() const {
+    return static_cast<size_t>(std::min<uint64_t>(total(), capacity()));
+}
+
+size_t SampleRing::copy_range(uint64_t first, uint64_t end, SampleWindow& out) const {
+    out.clear();
+    if (end <= first) return 0;
+
+    size_t n = static_cast<size_t>(end - first);
+    out.ts.resize(n);
+    out.temp.resize(n);
+    out.cond.resize(n);
+    out.pres.resize(n);
+
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = (first + k) & mask;
+        out.ts[k] = ts[i].load(std::memory_order_relaxed);
+        out.temp[k] = temp[i].load(std::memory_order_relaxed);
+        out.cond[k] = cond[i].load(std::memory_order_relaxed);
+        out.pres[k] = pres[i].load(std::memory_order_relaxed);
+    }
+
+    // Anything the producer claimed while we copied may be torn: drop that prefix
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t c = claimed.load(std::memory_order_relaxed);
+    uint64_t valid_from = c > capacity() ? c - capacity() : 0;
+    if (valid_from > first) {
+        size_t drop = static_cast<size_t>(std::min<uint64_t>(valid_from - first, n));
+        out.ts.erase(out.ts.begin(), out.ts.begin() + drop);
+        out.temp.erase(out.temp.begin(), out.temp.begin() + drop);
+        out.cond.erase(out.cond.begin(), out.cond.begin() + drop);
+        out.pres.erase(out.pres.begin(), out.pres.begin() + drop);
+    }
+    return out.size();
+}
+
+size_t SampleRing::snapshot_last(size_t count, SampleWindow& out) const {
+    uint64_t end = total();
+    uint64_t available = std::min<uint64_t>(end, capacity());
+    uint64_t n = std::min<uint64_t>(count, available);
+    return copy_range(end - n, end, out);
+}
+
+size_t SampleRing::snapshot_since(int64_t since_ns, SampleWindow& out) const {
+    uint64_t end = total();
+    uint64_t lo = end - std::min<uint64_t>(end, capacity());
+    uint64_t hi = end;
+
+    // Timestamps increase with the index, find the first one >= since_ns
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (ts[mid & mask].load(std::memory_order_relaxed) < since_ns) lo = mid + 1;
+        else hi = mid;
+    }
+    copy_range(lo, end, out);
+
+    // A slot overwritten during the search may have pushed lo too far back
+    size_t skip = 0;
+    while (skip < out.size() && out.ts[skip] < since_ns) ++skip;
+    if (skip) {
+        out.ts.erase(out.ts.begin(), out.ts.begin() + skip);
+        out.temp.erase(out.temp.begin(), out.temp.begin() + skip);
+        out.cond.erase(out.cond.begin(), out.cond.begin() + skip);
+        out.pres.erase(out.pres.begin(), out.pres.begin() + skip);
+    }
+    return out.size();
+}
+
+SampleRing& sample_ring() {
+    static SampleRing instance(RECORDER_RING_CAPACITY);
+    return instance;
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include "serial_sensor.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Copy of a contiguous run of samples, one array per channel
+struct SampleWindow {
+    std::vector<int64_t> ts;        // Nanoseconds: CLOCK_MONOTONIC from the ring, wall clock from the log
+    std::vector<float> temp;
+    std::vector<float> cond;
+    std::vector<float> pres;
+
+    size_t size() const { return ts.size(); }
+    void clear() { ts.clear(); temp.clear(); cond.clear(); pres.clear(); }
+};
+
+// Fixed-capacity ring of recent samples in structure-of-arrays layout.
+// One producer (the recorder thread) pushes; any number of readers take
+// snapshots without locks or retries. A reader that is overtaken by the
+// producer simply gets the part of its range that was not overwritten.
+class SampleRing {
+public:
+    explicit SampleRing(size_t capacity_pow2);
+
+    void push(int64_t ts_ns, const sensor_data_t& data);
+
+    size_t capacity() const { return mask + 1; }
+    uint64_t total() const { return head.load(std::memory_order_acquire); }
+    size_t size() const;
+
+    // Copy the newest `count` samples (fewer if not available). Returns the number copied.
+    size_t snapshot_last(size_t count, SampleWindow& out) const;
+
+    // Copy every sample with ts >= since_ns. Returns the number copied.
+    size_t snapshot_since(int64_t since_ns, SampleWindow& out) const;
+
+private:
+    size_t copy_range(uint64_t first, uint64_t end, SampleWindow& out) const;
+
+    size_t mask;
+    std::unique_ptr<std::atomic<int64_t>[]> ts;
+    std::unique_ptr<std::atomic<float>[]> temp;
+    std::unique_ptr<std::atomic<float>[]> cond;
+    std::unique_ptr<std::atomic<float>[]> pres;
+
+    std::atomic<uint64_t> claimed{ 0 };     // Samples the producer started writing
+    std::atomic<uint64_t> head{ 0 };        // Samples fully written
+};
+
+// Ring fed by the recorder thread
+SampleRing& sample_ring();
@@ -0,0 +1,336 @@
+﻿#include "sample_rollup.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+struct TierInfo {
+    const char* name;
+    int64_t width_ns;
+    uint64_t slots;
+};
+
+// Seconds for 6 hours, minutes for 30 days, hours for 5 years (about 11 MiB together)
+static const TierInfo TIERS[ROLLUP_TIERS] = {
+    { "1s", 1000000000LL, 6 * 3600 },
+    { "1m", 60 * 1000000000LL, 30 * 1440 },
+    { "1h", 3600 * 1000000000LL, 5 * 8766 },
+};
+
+// Retries before a reader gives up on a bucket the writer keeps changing (or left mid-update)
+static const int MAX_READ_RETRIES = 64;
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+static int64_t ceil_div(int64_t a, int64_t b) {
+    return -floor_div(-a, b);
+}
+
+int64_t rollup_width_ns(RollupTier tier) {
+    return TIERS[static_cast<int>(tier)].width_ns;
+}
+
+std::string rollup_path(const std::string& dir, RollupTier tier) {
+    return dir + "/rollup-" + TIERS[static_cast<int>(tier)].name + ".bin";
+}
+
+void RollupStats::merge(const RollupBucket& b) {
+    samples += b.samples;
+    for (int c = 0; c < 3; ++c) {
+        if (b.count[c] == 0) continue;
+        if (count[c] == 0 || b.min[c] < min[c]) min[c] = b.min[c];
+        if (count[c] == 0 || b.max[c] > max[c]) max[c] = b.max[c];
+        count[c] += b.count[c];
+        sum[c] += b.sum[c];
+        sumsq[c] += b.sumsq[c];
+    }
+}
+
+double RollupStats::stddev(int c) const {
+    if (count[c] < 2) return 0.0;
+    double m = mean(c);
+    double var = (sumsq[c] - m * sum[c]) / (count[c] - 1);
+    return var > 0.0 ? std::sqrt(var) : 0.0;
+}
+
+#ifndef _WIN32
+
+bool RollupRing::open(const std::string& path, RollupTier tier, bool write, bool* created) {
+    close();
+    const TierInfo& info = TIERS[static_cast<int>(tier)];
+    size_t size = ROLLUP_HEADER + info.slots * sizeof(RollupBucket);
+    writable = write;
+
+    fd = ::open(path.c_str(), write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        if (write) perror("Failed to open rollup");
+        return false;
+    }
+
+    RollupFileHeader h;
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == size &&
+        pread(fd, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h)) &&
+        h.magic == ROLLUP_MAGIC && h.version == ROLLUP_VERSION && h.header_size == ROLLUP_HEADER &&
+        h.width_ns == info.width_ns && h.slots == info.slots;
+
+    if (!valid) {
+        if (!write) {
+            close();
+            return false;
+        }
+        // New, resized or foreign file: start over with empty (sparse) buckets
+        memset(&h, 0, sizeof(h));
+        h.magic = ROLLUP_MAGIC;
+        h.version = ROLLUP_VERSION;
+        h.header_size = ROLLUP_HEADER;
+        h.width_ns = info.width_ns;
+        h.slots = info.slots;
+        h.newest = INT64_MIN;
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, static_cast<off_t>(size)) != 0 ||
+            pwrite(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h))) {
+            perror("Failed to create rollup");
+            close();
+            return false;
+        }
+        if (created) *created = true;
+    }
+
+    void* p = mmap(nullptr, size, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror("Failed to map rollup");
+        close();
+        return false;
+    }
+    base = static_cast<uint8_t*>(p);
+    mapped = size;
+    header = reinterpret_cast<RollupFileHeader*>(base);
+    buckets = reinterpret_cast<RollupBucket*>(base + ROLLUP_HEADER);
+    return true;
+}
+
+void RollupRing::close() {
+    if (base) munmap(base, mapped);
+    if (fd >= 0) ::close(fd);
+    base = nullptr;
+    mapped = 0;
+    header = nullptr;
+    buckets = nullptr;
+    fd = -1;
+}
+
+RollupBucket& RollupRing::slot(int64_t b) const {
+    int64_t slots = static_cast<int64_t>(header->slots);
+    int64_t i = b % slots;
+    return buckets[i < 0 ? i + slots : i];
+}
+
+int64_t RollupRing::newest() const {
+    return __atomic_load_n(&header->newest, __ATOMIC_ACQUIRE);
+}
+
+bool RollupRing::retained(int64_t b) const {
+    int64_t n = newest();
+    return n != INT64_MIN && b <= n && b > n - static_cast<int64_t>(header->slots);
+}
+
+void RollupRing::add(int64_t realtime_ns, const float values[3]) {
+    int64_t width = header->width_ns;
+    int64_t b = floor_div(realtime_ns, width);
+    RollupBucket& s = slot(b);
+
+    // Same protocol as SeqLock: odd while the bucket is inconsistent
+    uint32_t seq = s.seq | 1;
+    __atomic_store_n(&s.seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (s.samples == 0 || s.start_ns != b * width) {
+        uint32_t keep = s.seq;
+        memset(&s, 0, sizeof(s));
+        s.seq = keep;
+        s.start_ns = b * width;
+    }
+    ++s.samples;
+    for (int c = 0; c < 3; ++c) {
+        float v = values[c];
+        if (!std::isfinite(v)) continue;
+        if (s.count[c] == 0 || v < s.min[c]) s.min[c] = v;
+        if (s.count[c] == 0 || v > s.max[c]) s.max[c] = v;
+        ++s.count[c];
+        s.sum[c] += v;
+        s.sumsq[c] += static_cast<double>(v) * v;
+    }
+
+    __atomic_store_n(&s.seq, seq + 1, __ATOMIC_RELEASE);
+    if (header->newest == INT64_MIN || b > header->newest)
+        __atomic_store_n(&header->newest, b, __ATOMIC_RELEASE);
+}
+
+void RollupRing::clear_since(int64_t since_ns) {
+    int64_t n = header->newest;
+    if (n == INT64_MIN) return;
+
+    int64_t first = std::max(floor_div(since_ns, header->width_ns), n - static_cast<int64_t>(header->slots) + 1);
+    for (int64_t b = first; b <= n; ++b) {
+        RollupBucket& s = slot(b);
+        if (s.samples == 0) continue;
+        uint32_t seq = s.seq | 1;
+        __atomic_store_n(&s.seq, seq, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        s.samples = 0;
+        __atomic_store_n(&s.seq, seq + 1, __ATOMIC_RELEASE);
+    }
+}
+
+bool RollupRing::read(int64_t b, RollupBucket& out) const {
+    if (!retained(b)) return false;
+    const RollupBucket& s = slot(b);
+
+    for (int attempt = 0; attempt < MAX_READ_RETRIES; ++attempt) {
+        uint32_t s1 = __atomic_load_n(&s.seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) continue;
+        memcpy(&out, &s, sizeof(out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s.seq, __ATOMIC_RELAXED) != s1) continue;
+        return out.samples > 0 && out.start_ns == b * header->width_ns;
+    }
+    return false;
+}
+
+bool SampleRollups::open(const std::string& dir, bool* created) {
+    bool any_created = false;
+    for (int t = 0; t < ROLLUP_TIERS; ++t) {
+        RollupTier tier = static_cast<RollupTier>(t);
+        if (!tiers[t].open(rollup_path(dir, tier), tier, true, &any_created)) {
+            close();
+            return false;
+        }
+    }
+    // One tier missing means the others no longer match the log either
+    if (any_created) clear_since(INT64_MIN);
+    if (created) *created = any_created;
+    return true;
+}
+
+void SampleRollups::close() {
+    for (auto& r : tiers) r.close();
+}
+
+void SampleRollups::add(int64_t realtime_ns, const sensor_data_t& data) {
+    if (!is_open()) return;
+    const float values[3] = { data.value1, data.value2, data.value3 };
+    for (auto& r : tiers) r.add(realtime_ns, values);
+}
+
+void SampleRollups::clear_since(int64_t since_ns) {
+    for (auto& r : tiers)
+        if (r.is_open()) r.clear_since(since_ns);
+}
+
+static bool open_tiers(const std::string& dir, RollupRing (&rings)[ROLLUP_TIERS]) {
+    for (int t = 0; t < ROLLUP_TIERS; ++t)
+        if (!rings[t].open(rollup_path(dir, static_cast<RollupTier>(t)), static_cast<RollupTier>(t), false))
+            return false;
+    return true;
+}
+
+// [from, to) split into whole buckets of this tier and edges resolved one tier finer
+static void collect(const RollupRing* rings, int level, int64_t from, int64_t to, RollupStats& out) {
+    if (from >= to) return;
+    const RollupRing& r = rings[level];
+    int64_t w = r.width_ns();
+    RollupBucket b;
+
+    if (level == 0) {
+        for (int64_t i = floor_div(from, w), end = ceil_div(to, w); i < end; ++i)
+            if (r.read(i, b)) out.merge(b);
+        return;
+    }
+
+    int64_t first = ceil_div(from, w);
+    int64_t last = floor_div(to, w);
+    if (first >= last) {
+        collect(rings, level - 1, from, to, out);
+        return;
+    }
+    collect(rings, level - 1, from, first * w, out);
+    for (int64_t i = first; i < last; ++i)
+        if (r.read(i, b)) out.merge(b);
+    collect(rings, level - 1, last * w, to, out);
+}
+
+bool rollup_stats(const std::string& dir, int64_t from_ns, int64_t to_ns, RollupStats& out) {
+    out = RollupStats();
+    RollupRing rings[ROLLUP_TIERS];
+    if (!open_tiers(dir, rings)) return false;
+
+    // A start older than a tier keeps is rounded up to the next coarser boundary
+    for (int t = 0; t + 1 < ROLLUP_TIERS; ++t) {
+        int64_t n = rings[t].newest();
+        int64_t b = floor_div(from_ns, rings[t].width_ns());
+        if (n != INT64_MIN && b <= n - static_cast<int64_t>(TIERS[t].slots))
+            from_ns = ceil_div(from_ns, rings[t + 1].width_ns()) * rings[t + 1].width_ns();
+    }
+
+    collect(rings, ROLLUP_TIERS - 1, from_ns, to_ns, out);
+    return true;
+}
+
+int64_t rollup_retained_from_ns(const std::string& dir, RollupTier tier) {
+    RollupRing ring;
+    if (!ring.open(rollup_path(dir, tier), tier, false)) return INT64_MAX;
+
+    int64_t n = ring.newest();
+    if (n == INT64_MIN) return INT64_MAX;
+    return (n - static_cast<int64_t>(TIERS[static_cast<int>(tier)].slots) + 1) * ring.width_ns();
+}
+
+size_t rollup_buckets(const std::string& dir, RollupTier tier, int64_t from_ns, int64_t to_ns,
+    std::vector<RollupBucket>& out) {
+    out.clear();
+    RollupRing ring;
+    if (!ring.open(rollup_path(dir, tier), tier, false)) return 0;
+
+    int64_t n = ring.newest();
+    if (n == INT64_MIN) return 0;
+    int64_t w = ring.width_ns();
+    int64_t first = std::max(floor_div(from_ns, w), n - static_cast<int64_t>(TIERS[static_cast<int>(tier)].slots) + 1);
+    int64_t end = std::min(ceil_div(to_ns, w), n + 1);
+
+    RollupBucket b;
+    for (int64_t i = first; i < end; ++i)
+        if (ring.read(i, b)) out.push_back(b);
+    return out.size();
+}
+
+#else
+
+// The Windows simulator has no sample store
+bool RollupRing::open(const std::string&, RollupTier, bool, bool*) { return false; }
+void RollupRing::close() {}
+RollupBucket& RollupRing::slot(int64_t) const { return *buckets; }
+int64_t RollupRing::newest() const { return INT64_MIN; }
+bool RollupRing::retained(int64_t) const { return false; }
+void RollupRing::add(int64_t, const float[3]) {}
+void RollupRing::clear_since(int64_t) {}
+bool RollupRing::read(int64_t, RollupBucket&) const { return false; }
+bool SampleRollups::open(const std::string&, bool*) { return false; }
+void SampleRollups::close() {}
+void SampleRollups::add(int64_t, const sensor_data_t&) {}
+void SampleRollups::clear_since(int64_t) {}
+bool rollup_stats(const std::string&, int64_t, int64_t, RollupStats& out) { out = RollupStats(); return false; }
+int64_t rollup_retained_from_ns(const std::string&, RollupTier) { return INT64_MAX; }
+size_t rollup_buckets(const std::string&, RollupTier, int64_t, int64_t, std::vector<RollupBucket>& out) { out.clear(); return 0; }
+
+#endif
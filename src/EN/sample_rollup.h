@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include "serial_sensor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Pre-aggregated rollups of the sample log in three tiers (1 s, 1 min, 1 h),
+// maintained at ingest and stored next to the segments ("rollup-1s.bin", ...).
+//
+// Each tier is a fixed ring of buckets addressed by time: bucket b (start = b * width)
+// lives in slot b % slots, so folding a sample is one lookup and a window query reads
+// exactly the buckets it covers. A slot whose start does not match is empty or was
+// overwritten by a newer bucket. Windowed averages and long-range charts read a few
+// hundred buckets instead of millions of raw samples, and the tiers keep their history
+// after the raw segments have been deleted by retention.
+
+#define ROLLUP_MAGIC    0x4C4C4F52u     // "ROLL"
+#define ROLLUP_VERSION  1
+#define ROLLUP_HEADER   128
+
+enum class RollupTier { Second, Minute, Hour };
+static const int ROLLUP_TIERS = 3;
+
+struct RollupFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    int64_t  width_ns;
+    uint64_t slots;
+    int64_t  newest;            // Highest bucket number written; older than newest - slots is gone
+    uint8_t  reserved[96];
+};
+
+struct RollupBucket {
+    int64_t  start_ns;          // Wall clock, a multiple of the tier width
+    uint32_t seq;               // Odd while the writer is updating the bucket
+    uint32_t samples;
+    uint32_t count[3];          // Finite values per channel (temperature, conductivity, pressure)
+    float    min[3];
+    float    max[3];
+    uint32_t reserved;
+    double   sum[3];
+    double   sumsq[3];
+};
+
+static_assert(sizeof(RollupFileHeader) == ROLLUP_HEADER, "rollup header size");
+static_assert(sizeof(RollupBucket) == 104, "rollup bucket size");
+
+// Sum of buckets
+struct RollupStats {
+    uint64_t samples = 0;
+    uint64_t count[3] = {};
+    float min[3] = {};
+    float max[3] = {};
+    double sum[3] = {};
+    double sumsq[3] = {};
+
+    void merge(const RollupBucket& b);
+    double mean(int c) const { return count[c] ? sum[c] / count[c] : 0.0; }
+    double stddev(int c) const;
+};
+
+int64_t rollup_width_ns(RollupTier tier);
+
+// Ring of one tier, mapped for reading or writing
+class RollupRing {
+public:
+    RollupRing() = default;
+    ~RollupRing() { close(); }
+
+    // Returns false on failure; `created` is set if the file was new or unusable and has been reset
+    bool open(const std::string& path, RollupTier tier, bool writable, bool* created = nullptr);
+    void close();
+    bool is_open() const { return buckets != nullptr; }
+
+    void add(int64_t realtime_ns, const float values[3]);
+    void clear_since(int64_t since_ns);     // Empties every retained bucket from since_ns on
+
+    int64_t width_ns() const { return header->width_ns; }
+    int64_t newest() const;
+    bool retained(int64_t bucket) const;
+
+    // Consistent copy of bucket `b`; false if it is empty, evicted or not written yet
+    bool read(int64_t b, RollupBucket& out) const;
+
+private:
+    RollupBucket& slot(int64_t b) const;
+
+    int fd = -1;
+    uint8_t* base = nullptr;
+    size_t mapped = 0;
+    RollupFileHeader* header = nullptr;
+    RollupBucket* buckets = nullptr;
+    bool writable = false;
+
+    RollupRing(const RollupRing&) = delete;
+    RollupRing& operator=(const RollupRing&) = delete;
+};
+
+// All tiers of a store directory. Written from the store's thread only.
+class SampleRollups {
+public:
+    bool open(const std::string& dir, bool* created = nullptr);
+    void close();
+    bool is_open() const { return tiers[0].is_open(); }
+
+    void add(int64_t realtime_ns, const sensor_data_t& data);
+    void clear_since(int64_t since_ns);
+
+private:
+    RollupRing tiers[ROLLUP_TIERS];
+};
+
+std::string rollup_path(const std::string& dir, RollupTier tier);
+
+// Aggregate of [from_ns, to_ns) from the finest tiers that cover it: whole hours from the
+// hour tier, the remainder from minutes and seconds. An edge older than a tier's retention
+// is resolved at the next coarser tier. Returns false if the store has no rollups.
+bool rollup_stats(const std::string& dir, int64_t from_ns, int64_t to_ns, RollupStats& out);
+
+// Start of the oldest bucket a tier still keeps; INT64_MAX if the store has no rollups
+int64_t rollup_retained_from_ns(const std::string& dir, RollupTier tier);
+
+// Non-empty buckets of one tier in [from_ns, to_ns), oldest first (for charts)
+size_t rollup_buckets(const std::string& dir, RollupTier tier, int64_t from_ns, int64_t to_ns,
+    std::vector<RollupBucket>& out);
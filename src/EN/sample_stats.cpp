@@ -0,0 +1,221 @@
+﻿#include "sample_stats.h"
+#include "sample_ring.h"
+
+#include <math.h>
+#include <algorithm>
+
+void RunningMoments::add(double x) {
+    ++n;
+    double d = x - mean;
+    mean += d / static_cast<double>(n);
+    m2 += d * (x - mean);
+}
+
+void RunningMoments::remove(double x) {
+    if (n <= 1) {
+        *this = RunningMoments();
+        return;
+    }
+    double d = x - mean;
+    mean -= d / static_cast<double>(n - 1);
+    m2 -= d * (x - mean);
+    if (m2 < 0.0) m2 = 0.0;
+    --n;
+}
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+void SlidingWindow::reset(size_t limit_pow2) {
+    limit = round_up_pow2(std::max<size_t>(limit_pow2, 1));
+    allocate(std::min<size_t>(limit, 64));
+}
+
+void SlidingWindow::allocate(size_t capacity) {
+    ts.assign(capacity, 0);
+    for (int c = 0; c < 3; ++c) {
+        values[c].assign(capacity, 0.0f);
+        min_queue[c].index.assign(capacity, 0);
+        min_queue[c].front = min_queue[c].back = 0;
+        max_queue[c].index.assign(capacity, 0);
+        max_queue[c].front = max_queue[c].back = 0;
+        moments[c] = RunningMoments();
+    }
+    mask = capacity - 1;
+    head = tail = 0;
+    removed = 0;
+}
+
+// Doubles the ring by replaying the window into a larger one; amortized O(1) per sample
+void SlidingWindow::grow() {
+    SlidingWindow bigger;
+    bigger.limit = limit;
+    bigger.allocate((mask + 1) * 2);
+    for (uint64_t k = tail; k != head; ++k) {
+        size_t i = k & mask;
+        const float v[3] = { values[0][i], values[1][i], values[2][i] };
+        bigger.push(ts[i], v);
+    }
+    *this = std::move(bigger);
+}
+
+void SlidingWindow::push(int64_t ts_ns, const float v[3]) {
+    if (size() == mask + 1) {
+        if (mask + 1 < limit) grow();
+        else pop();
+    }
+
+    size_t i = head & mask;
+    ts[i] = ts_ns;
+    for (int c = 0; c < 3; ++c) {
+        values[c][i] = v[c];
+        if (!isfinite(v[c])) continue;
+        moments[c].add(v[c]);
+
+        // A new value retires every queued one it beats; they can never be the extreme again
+        MonotonicQueue& lo = min_queue[c];
+        while (lo.back != lo.front && values[c][lo.index[(lo.back - 1) & mask] & mask] >= v[c]) --lo.back;
+        lo.index[lo.back++ & mask] = static_cast<uint32_t>(head);
+
+        MonotonicQueue& hi = max_queue[c];
+        while (hi.back != hi.front && values[c][hi.index[(hi.back - 1) & mask] & mask] <= v[c]) --hi.back;
+        hi.index[hi.back++ & mask] = static_cast<uint32_t>(head);
+    }
+    ++head;
+}
+
+void SlidingWindow::pop() {
+    if (head == tail) return;
+
+    size_t i = tail & mask;
+    for (int c = 0; c < 3; ++c) {
+        if (!isfinite(values[c][i])) continue;
+        moments[c].remove(values[c][i]);
+
+        MonotonicQueue& lo = min_queue[c];
+        if (lo.front != lo.back && lo.index[lo.front & mask] == static_cast<uint32_t>(tail)) ++lo.front;
+        MonotonicQueue& hi = max_queue[c];
+        if (hi.front != hi.back && hi.index[hi.front & mask] == static_cast<uint32_t>(tail)) ++hi.front;
+    }
+    ++tail;
+
+    // Removal leaves rounding behind; sum the window again once per window length
+    if (++removed > size()) resum();
+}
+
+void SlidingWindow::resum() {
+    for (int c = 0; c < 3; ++c) {
+        moments[c] = RunningMoments();
+        for (uint64_t k = tail; k != head; ++k) {
+            float x = values[c][k & mask];
+            if (isfinite(x)) moments[c].add(x);
+        }
+    }
+    removed = 0;
+}
+
+void SlidingWindow::fill(WindowStats& out) const {
+    out.samples = static_cast<uint32_t>(size());
+    for (int c = 0; c < 3; ++c) {
+        out.count[c] = static_cast<uint32_t>(moments[c].n);
+        out.mean[c] = static_cast<float>(moments[c].mean);
+        out.stddev[c] = static_cast<float>(sqrt(moments[c].variance()));
+        const MonotonicQueue& lo = min_queue[c];
+        const MonotonicQueue& hi = max_queue[c];
+        out.min[c] = lo.front != lo.back ? values[c][lo.index[lo.front & mask] & mask] : 0.0f;
+        out.max[c] = hi.front != hi.back ? values[c][hi.index[hi.front & mask] & mask] : 0.0f;
+    }
+}
+
+SampleStats::SampleStats() {
+    by_count.reset(1);
+    by_time.reset(1);
+}
+
+void SampleStats::configure(uint32_t samples, uint32_t minutes) {
+    want_samples.store(std::min<uint32_t>(std::max<uint32_t>(samples, 1), STATS_COUNT_LIMIT));
+    want_minutes.store(std::max<uint32_t>(minutes, 1));
+}
+
+void SampleStats::add(int64_t ts_ns, const sensor_data_t& data) {
+    if (want_samples.load(std::memory_order_relaxed) != window_samples ||
+        want_minutes.load(std::memory_order_relaxed) != window_minutes) {
+        apply_config(ts_ns);
+    }
+    else {
+        const float v[3] = { data.value1, data.value2, data.value3 };
+        fold(ts_ns, v);
+    }
+    ++seen;
+    publish();
+}
+
+// Starts both windows over from the recent samples in the ring, so a new length has
+// values right away instead of filling up from nothing
+void SampleStats::apply_config(int64_t ts_ns) {
+    window_samples = want_samples.load();
+    window_minutes = want_minutes.load();
+    by_count.reset(window_samples);
+    by_time.reset(STATS_TIME_LIMIT);
+    for (int c = 0; c < 3; ++c) ewma_started[c] = false;
+
+    SampleWindow w;
+    sample_ring().snapshot_since(ts_ns - window_minutes * 60LL * 1000000000LL, w);
+    time_covered = sample_ring().size() > w.size();
+    for (size_t i = 0; i < w.size(); ++i) {
+        const float v[3] = { w.temp[i], w.cond[i], w.pres[i] };
+        by_time.push(w.ts[i], v);
+    }
+
+    sample_ring().snapshot_last(window_samples, w);
+    for (size_t i = 0; i < w.size(); ++i) {
+        const float v[3] = { w.temp[i], w.cond[i], w.pres[i] };
+        by_count.push(w.ts[i], v);
+        update_ewma(v);
+    }
+}
+
+void SampleStats::fold(int64_t ts_ns, const float v[3]) {
+    if (by_count.size() == window_samples) by_count.pop();
+    by_count.push(ts_ns, v);
+
+    by_time.push(ts_ns, v);
+    int64_t since_ns = ts_ns - window_minutes * 60LL * 1000000000LL;
+    while (by_time.size() > 0 && by_time.oldest_ts() < since_ns) {
+        by_time.pop();
+        time_covered = true;
+    }
+
+    update_ewma(v);
+}
+
+// Span of the count window: alpha = 2 / (N + 1)
+void SampleStats::update_ewma(const float v[3]) {
+    double alpha = 2.0 / (window_samples + 1.0);
+    for (int c = 0; c < 3; ++c) {
+        if (!isfinite(v[c])) continue;
+        ewma[c] = ewma_started[c] ? ewma[c] + alpha * (v[c] - ewma[c]) : v[c];
+        ewma_started[c] = true;
+    }
+}
+
+void SampleStats::publish() {
+    StatsSnapshot s;
+    s.seq = seen;
+    s.window_samples = window_samples;
+    s.window_minutes = window_minutes;
+    by_count.fill(s.by_count);
+    s.by_count.complete = by_count.size() == window_samples;
+    by_time.fill(s.by_time);
+    s.by_time.complete = time_covered && !by_time.at_limit();
+    for (int c = 0; c < 3; ++c) s.ewma[c] = static_cast<float>(ewma[c]);
+    published.store(s);
+}
+
+SampleStats& sample_stats() {
+    static SampleStats instance;
+    return instance;
+}
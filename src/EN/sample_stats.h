@@ -0,0 +1,128 @@
+﻿#pragma once
+
+#include "serial_sensor.h"
+#include "seqlock.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streaming statistics for the Average Data screen, fed by the recorder thread.
+//
+// Two sliding windows, the newest N samples and the last M minutes, keep a Welford
+// mean / variance per channel that is updated on every add and remove, and min / max in
+// monotonic queues, so a sample costs O(1) amortized whatever the window length. An EWMA
+// per channel follows the span of the count window. The results are published through a
+// SeqLock after every sample; the screen reads them without touching the log.
+
+#define STATS_COUNT_LIMIT (1u << 16)        // Longest count window, the size of the sample ring
+#define STATS_TIME_LIMIT  (1u << 17)        // Samples a time window can hold, 1 h at 36 Hz
+
+struct WindowStats {
+    uint32_t samples = 0;
+    uint32_t count[3] = {};         // Finite values per channel (temperature, conductivity, pressure)
+    float mean[3] = {};
+    float min[3] = {};
+    float max[3] = {};
+    float stddev[3] = {};
+    bool complete = false;          // Covers the whole window, not still filling up or cut at capacity
+};
+
+struct StatsSnapshot {
+    uint64_t seq = 0;               // Samples seen
+    uint32_t window_samples = 0;    // Window lengths the values belong to
+    uint32_t window_minutes = 0;
+    WindowStats by_count;
+    WindowStats by_time;
+    float ewma[3] = {};
+};
+
+// Mean and sum of squared deviations (Welford), with removal for sliding windows
+struct RunningMoments {
+    uint64_t n = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+
+    void add(double x);
+    void remove(double x);
+    double variance() const { return n > 1 ? m2 / static_cast<double>(n - 1) : 0.0; }
+};
+
+// Samples of one window in a ring, oldest first. The ring doubles as needed up to `limit`;
+// a push beyond that drops the oldest sample.
+class SlidingWindow {
+public:
+    void reset(size_t limit_pow2);
+
+    void push(int64_t ts_ns, const float v[3]);
+    void pop();
+
+    size_t size() const { return static_cast<size_t>(head - tail); }
+    bool at_limit() const { return size() == limit; }
+    int64_t oldest_ts() const { return ts[tail & mask]; }
+
+    void fill(WindowStats& out) const;
+
+private:
+    // Sample indices whose values are increasing (min) or decreasing (max) from the front
+    struct MonotonicQueue {
+        std::vector<uint32_t> index;        // Low bits of the sample number, unique within the ring
+        uint64_t front = 0, back = 0;
+    };
+
+    void allocate(size_t capacity);
+    void grow();
+    void resum();
+
+    std::vector<int64_t> ts;
+    std::vector<float> values[3];
+    size_t mask = 0;
+    size_t limit = 0;
+    uint64_t head = 0, tail = 0;
+
+    RunningMoments moments[3];
+    MonotonicQueue min_queue[3];
+    MonotonicQueue max_queue[3];
+    size_t removed = 0;             // Since the moments were last summed from scratch
+};
+
+class SampleStats {
+public:
+    SampleStats();
+
+    // Window lengths wanted by the screen; the recorder applies them with its next sample
+    void configure(uint32_t samples, uint32_t minutes);
+
+    // Recorder thread, after the sample went into sample_ring() (a new configuration is seeded from it)
+    void add(int64_t ts_ns, const sensor_data_t& data);
+
+    StatsSnapshot snapshot() const { return published.load(); }
+    uint32_t version() const { return published.version(); }
+
+private:
+    void apply_config(int64_t ts_ns);
+    void fold(int64_t ts_ns, const float v[3]);
+    void update_ewma(const float v[3]);
+    void publish();
+
+    std::atomic<uint32_t> want_samples{ 10 };
+    std::atomic<uint32_t> want_minutes{ 10 };
+    uint32_t window_samples = 0;
+    uint32_t window_minutes = 0;
+
+    SlidingWindow by_count;
+    SlidingWindow by_time;
+    bool time_covered = false;      // The time window has lost samples to age, so it reaches back its full length
+    double ewma[3] = {};
+    bool ewma_started[3] = {};
+    uint64_t seen = 0;
+
+    SeqLock<StatsSnapshot> published;
+
+    SampleStats(const SampleStats&) = delete;
+    SampleStats& operator=(const SampleStats&) = delete;
+};
+
+// Statistics fed by the recorder thread
+SampleStats& sample_stats();
@@ -0,0 +1,342 @@
+﻿#include "sample_store.h"
+#include "sample_codec.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef SAMPLE_LOG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+size_t store_read_last(const std::string& dir, size_t count, SampleWindow& out) {
+    out.clear();
+    return store_for_last(dir, count, [&out](const LogSpan& s) { append_span(s, out); });
+}
+
+size_t store_read_since(const std::string& dir, int64_t since_ns, SampleWindow& out) {
+    out.clear();
+    return store_for_since(dir, since_ns, [&out](const LogSpan& s) { append_span(s, out); });
+}
+
+#ifndef _WIN32
+
+static const int64_t ROLLUP_REPAIR_NS = 10 * 60 * 1000000000LL;
+
+static std::string segment_path(const std::string& dir, uint64_t seq) {
+    char name[32];
+    snprintf(name, sizeof(name), "/seg-%06llu.bin", static_cast<unsigned long long>(seq));
+    return dir + name;
+}
+
+static uint64_t file_size(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+// Time range of a closed segment from its index, left open-ended if the index is incomplete
+static void read_index_range(SegmentInfo& seg) {
+    std::string index_path = sample_log_index_path(seg.path);
+    uint64_t entries = file_size(index_path) / sizeof(LogIndexEntry);
+    if (entries == 0) return;
+    if (!seg.compressed && entries * SAMPLE_LOG_BLOCK != file_size(seg.path)) return;
+
+    int fd = ::open(index_path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    LogIndexEntry first, last;
+    if (pread(fd, &first, sizeof(first), 0) == static_cast<ssize_t>(sizeof(first)) &&
+        pread(fd, &last, sizeof(last), static_cast<off_t>((entries - 1) * sizeof(last))) == static_cast<ssize_t>(sizeof(last))) {
+        seg.first_ts_ns = first.first_ts_ns;
+        seg.max_ts_ns = last.max_ts_ns;
+    }
+    ::close(fd);
+}
+
+std::vector<SegmentInfo> list_segments(const std::string& dir) {
+    std::map<uint64_t, SegmentInfo> found;
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) return {};
+    while (struct dirent* e = readdir(d)) {
+        unsigned long long seq;
+        char suffix[16] = "";
+        if (sscanf(e->d_name, "seg-%llu.%15s", &seq, suffix) != 2) continue;
+
+        bool compressed = strcmp(suffix, "bin.gz") == 0 || strcmp(suffix, "bin" SAMPLE_CODEC_SUFFIX) == 0;
+        if (!compressed && strcmp(suffix, "bin") != 0) continue;
+
+        // While a segment is being compressed both files exist; the plain one is authoritative
+        SegmentInfo& seg = found[seq];
+        if (!seg.path.empty() && !seg.compressed) continue;
+        seg.seq = seq;
+        seg.path = dir + "/" + e->d_name;
+        seg.compressed = compressed;
+    }
+    closedir(d);
+
+    std::vector<SegmentInfo> result;
+    for (auto& kv : found) {
+        SegmentInfo& seg = kv.second;
+        seg.bytes = file_size(seg.path) + file_size(sample_log_index_path(seg.path));
+        result.push_back(seg);
+    }
+    // The newest segment has an open block that is not indexed yet
+    for (size_t i = 0; i + 1 < result.size(); ++i)
+        read_index_range(result[i]);
+    return result;
+}
+
+bool SampleStore::open(const SampleStoreConfig& config) {
+    close();
+    cfg = config;
+
+    if (mkdir(cfg.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        perror("Failed to create sample store");
+        return false;
+    }
+
+    std::vector<SegmentInfo> segments = list_segments(cfg.dir);
+
+    // A single-file log from an earlier version becomes the first segment
+    if (segments.empty() && access(SAMPLE_LOG_PATH, F_OK) == 0) {
+        std::string seg = segment_path(cfg.dir, 0);
+        if (rename(SAMPLE_LOG_PATH, seg.c_str()) == 0) {
+            rename(sample_log_index_path(SAMPLE_LOG_PATH).c_str(), sample_log_index_path(seg).c_str());
+            segments = list_segments(cfg.dir);
+        }
+    }
+
+    if (segments.empty())
+        seq = 1;
+    else
+        seq = segments.back().compressed ? segments.back().seq + 1 : segments.back().seq;
+
+    if (!open_segment(seq)) return false;
+
+    bool created = false;
+    if (rollups.open(cfg.dir, &created))
+        rebuild_rollups(created);
+
+    start_maintenance();
+    return true;
+}
+
+// Rollups are derived from the log. New ones are built from all of it; otherwise the
+// hours from ROLLUP_REPAIR_NS before the newest sample are folded again, which restores
+// buckets whose pages did not reach the disk before a crash (dirty pages are written
+// back within about 30 s). Hours are cleared whole, so the cost is at most two hours.
+void SampleStore::rebuild_rollups(bool all) {
+    int64_t since = INT64_MIN;
+    if (!all) {
+        int64_t last = INT64_MIN;
+        store_for_last(cfg.dir, 1, [&last](const LogSpan& s) { last = s.ts(s.count - 1); });
+        if (last == INT64_MIN) return;
+        int64_t hour = rollup_width_ns(RollupTier::Hour);
+        last -= ROLLUP_REPAIR_NS;
+        since = last - ((last % hour) + hour) % hour;
+    }
+
+    rollups.clear_since(since);
+    store_for_since(cfg.dir, since, [this](const LogSpan& s) {
+        for (size_t i = 0; i < s.count; ++i)
+            rollups.add(s.ts(i), { s.temp[i], s.cond[i], s.pres[i] });
+    });
+}
+
+void SampleStore::close() {
+    writer.close();
+    rollups.close();
+    if (maintenance.joinable()) maintenance.join();
+}
+
+bool SampleStore::open_segment(uint64_t n) {
+    seq = n;
+    return writer.open(segment_path(cfg.dir, seq).c_str(), cfg.durability);
+}
+
+bool SampleStore::add(int64_t realtime_ns, const sensor_data_t& data) {
+    if (!writer.is_open()) return false;
+
+    if (writer.block_full() && writer.blocks_used() * SAMPLE_LOG_BLOCK >= cfg.segment_bytes)
+        roll_over();
+    if (!writer.add(realtime_ns, data)) return false;
+    rollups.add(realtime_ns, data);
+    return true;
+}
+
+// The sealed segment is fully indexed before the next one exists, so a reader always
+// sees the newest file as the open segment and every older one as complete
+void SampleStore::roll_over() {
+    writer.seal();
+    writer.close();
+    if (!open_segment(seq + 1)) return;
+    start_maintenance();
+}
+
+void SampleStore::start_maintenance() {
+    if (maintenance.joinable()) maintenance.join();
+    SampleStoreConfig config = cfg;
+    maintenance = std::thread([config] { apply_retention(config); });
+}
+
+#ifdef SAMPLE_LOG_HAVE_ZLIB
+static bool gzip_file(const std::string& path, const std::string& tmp) {
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    gzFile out = gzopen(tmp.c_str(), "wb6");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    bool ok = true;
+    char chunk[64 * 1024];
+    size_t n;
+    while (ok && (n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+        ok = gzwrite(out, chunk, static_cast<unsigned>(n)) == static_cast<int>(n);
+    ok = ok && !ferror(in);
+    fclose(in);
+    return gzclose(out) == Z_OK && ok;
+}
+#endif
+
+// Writes the encoded segment next to the plain one, then atomically replaces it.
+// Returns the new path, or an empty string if the segment was kept as is.
+static std::string compress_segment(const std::string& path, SegmentCodec codec) {
+    std::string target = path + (codec == SegmentCodec::Gorilla ? SAMPLE_CODEC_SUFFIX : ".gz");
+    std::string tmp = target + ".tmp";
+
+    bool ok = false;
+    if (codec == SegmentCodec::Gorilla) {
+        ok = gorilla_encode_file(path, tmp);
+    }
+    else {
+#ifdef SAMPLE_LOG_HAVE_ZLIB
+        ok = gzip_file(path, tmp);
+#else
+        fprintf(stderr, "Sample store gzip compression needs zlib, segments are kept as is\n");
+        return std::string();
+#endif
+    }
+
+    if (!ok || rename(tmp.c_str(), target.c_str()) != 0) {
+        unlink(tmp.c_str());
+        fprintf(stderr, "Failed to compress %s\n", path.c_str());
+        return std::string();
+    }
+    unlink(path.c_str());
+    return target;
+}
+
+void apply_retention(const SampleStoreConfig& config) {
+    std::vector<SegmentInfo> segments = list_segments(config.dir);
+    if (segments.size() < 2) return;
+    segments.pop_back();        // Never touch the segment being written
+
+    if (config.compress != SegmentCodec::None) {
+        for (auto& seg : segments) {
+            if (seg.compressed) continue;
+            std::string path = compress_segment(seg.path, config.compress);
+            if (path.empty()) continue;
+            seg.path = path;
+            seg.compressed = true;
+            seg.bytes = file_size(seg.path) + file_size(sample_log_index_path(seg.path));
+        }
+    }
+
+    uint64_t total = 0;
+    for (const auto& seg : list_segments(config.dir))
+        total += seg.bytes;
+
+    using namespace std::chrono;
+    int64_t now_ns = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+    int64_t oldest_ns = now_ns - config.max_age_days * 86400LL * 1000000000LL;
+
+    for (const auto& seg : segments) {
+        bool too_big = config.max_total_bytes && total > config.max_total_bytes;
+        bool too_old = config.max_age_days > 0 && seg.max_ts_ns < oldest_ns;
+        if (!too_big && !too_old) continue;
+
+        unlink(seg.path.c_str());
+        unlink(sample_log_index_path(seg.path).c_str());
+        total -= std::min(total, seg.bytes);
+    }
+}
+
+size_t store_for_since(const std::string& dir, int64_t since_ns, const SpanVisitor& f) {
+    size_t visited = 0;
+    for (const auto& seg : list_segments(dir)) {
+        if (seg.max_ts_ns < since_ns) continue;
+        SampleLogView view;
+        if (view.open(seg.path.c_str()))
+            visited += view.for_since(since_ns, f);
+    }
+    return visited;
+}
+
+size_t store_for_range(const std::string& dir, int64_t from_ns, int64_t to_ns, const SpanVisitor& f) {
+    size_t visited = 0;
+    for (const auto& seg : list_segments(dir)) {
+        if (seg.max_ts_ns < from_ns) continue;
+        if (seg.first_ts_ns != INT64_MIN && seg.first_ts_ns >= to_ns) break;
+        SampleLogView view;
+        if (!view.open(seg.path.c_str())) continue;
+        visited += view.for_since(from_ns, [&](const LogSpan& s) {
+            if (s.header->first_ts_ns < to_ns) f(s);
+        });
+        if (seg.max_ts_ns >= to_ns) break;
+    }
+    return visited;
+}
+
+size_t store_for_last(const std::string& dir, size_t count, const SpanVisitor& f) {
+    std::vector<SegmentInfo> segments = list_segments(dir);
+
+    // Walk back over segments until enough samples are found; the views stay open
+    // until the spans have been visited in order
+    std::vector<std::unique_ptr<SampleLogView>> views;
+    std::vector<std::vector<LogSpan>> spans;
+    size_t found = 0;
+    for (auto it = segments.rbegin(); it != segments.rend() && found < count; ++it) {
+        std::unique_ptr<SampleLogView> view(new SampleLogView());
+        if (!view->open(it->path.c_str())) continue;
+
+        std::vector<LogSpan> list;
+        found += view->for_last(count - found, [&list](const LogSpan& s) { list.push_back(s); });
+        views.push_back(std::move(view));
+        spans.push_back(std::move(list));
+    }
+
+    for (auto it = spans.rbegin(); it != spans.rend(); ++it)
+        for (const auto& s : *it) f(s);
+    return found;
+}
+
+#else
+
+// The Windows simulator has no sample store
+std::vector<SegmentInfo> list_segments(const std::string&) { return {}; }
+bool SampleStore::open(const SampleStoreConfig&) { return false; }
+void SampleStore::close() {}
+bool SampleStore::open_segment(uint64_t) { return false; }
+bool SampleStore::add(int64_t, const sensor_data_t&) { return false; }
+void SampleStore::roll_over() {}
+void SampleStore::rebuild_rollups(bool) {}
+void SampleStore::start_maintenance() {}
+void apply_retention(const SampleStoreConfig&) {}
+size_t store_for_since(const std::string&, int64_t, const SpanVisitor&) { return 0; }
+size_t store_for_range(const std::string&, int64_t, int64_t, const SpanVisitor&) { return 0; }
+size_t store_for_last(const std::string&, size_t, const SpanVisitor&) { return 0; }
+
+#endif
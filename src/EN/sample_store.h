@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include "sample_log.h"
+#include "sample_rollup.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define SAMPLE_STORE_DIR "/etc/sensor_data"
+
+// Segmented sample storage. The log is split into numbered segment files
+// ("seg-000001.bin" plus its ".idx"); only the newest one is written. A full
+// segment is sealed and a new one started, closed segments may be compressed,
+// and the oldest are deleted once they exceed the age or size budget. Queries
+// only open the segments that overlap the requested window. Rollup tiers
+// (sample_rollup.h) are kept in the same directory and updated on every add.
+
+// Encoding of closed segments
+enum class SegmentCodec {
+    None,
+    Gzip,           // "*.bin.gz", needs zlib
+    Gorilla         // "*.bin.gor", delta-of-delta / XOR columns (sample_codec.h)
+};
+
+struct SampleStoreConfig {
+    std::string dir = SAMPLE_STORE_DIR;
+    uint64_t segment_bytes = 4ULL << 20;        // Rolled over at the first block boundary past this size
+    uint64_t max_total_bytes = 256ULL << 20;    // All segments together, 0 = unlimited
+    int max_age_days = 0;                       // Segments that end before this are deleted, 0 = keep
+    SegmentCodec compress = SegmentCodec::None;
+    LogDurability durability = LogDurability::None;
+};
+
+struct SegmentInfo {
+    uint64_t seq = 0;
+    std::string path;               // Log file, "*.bin", "*.bin.gz" or "*.bin.gor"
+    bool compressed = false;
+    uint64_t bytes = 0;             // Log and index on disk
+    int64_t first_ts_ns = INT64_MIN;    // Time range from the index; unknown ranges are open-ended
+    int64_t max_ts_ns = INT64_MAX;
+};
+
+// Segments in the directory, oldest first. The last one is the segment being written.
+std::vector<SegmentInfo> list_segments(const std::string& dir);
+
+// Owns the segment being written. Used from one thread only (the recorder or its committer).
+class SampleStore {
+public:
+    SampleStore() = default;
+    ~SampleStore() { close(); }
+
+    bool open(const SampleStoreConfig& config);
+    void close();
+    bool is_open() const { return writer.is_open(); }
+
+    // add() buffers, commit() makes everything added so far visible (and durable, per config)
+    bool add(int64_t realtime_ns, const sensor_data_t& data);
+    bool commit() { return writer.commit(); }
+    bool append(int64_t realtime_ns, const sensor_data_t& data) { return add(realtime_ns, data) && commit(); }
+
+private:
+    bool open_segment(uint64_t seq);
+    void roll_over();
+    void rebuild_rollups(bool all);
+    void start_maintenance();
+
+    SampleStoreConfig cfg;
+    SampleLogWriter writer;
+    SampleRollups rollups;
+    uint64_t seq = 0;
+    std::thread maintenance;        // Compression and retention run off the recorder thread
+
+    SampleStore(const SampleStore&) = delete;
+    SampleStore& operator=(const SampleStore&) = delete;
+};
+
+// Compresses closed segments (if enabled) and deletes the ones outside the retention budget
+void apply_retention(const SampleStoreConfig& config);
+
+using SpanVisitor = std::function<void(const LogSpan&)>;
+
+// Queries over all segments, oldest first. Only segments overlapping the window are opened.
+size_t store_for_last(const std::string& dir, size_t count, const SpanVisitor& f);
+size_t store_for_since(const std::string& dir, int64_t since_ns, const SpanVisitor& f);
+
+// Spans that may hold samples in [from_ns, to_ns); spans at the edges also hold samples outside it
+size_t store_for_range(const std::string& dir, int64_t from_ns, int64_t to_ns, const SpanVisitor& f);
+
+size_t store_read_last(const std::string& dir, size_t count, SampleWindow& out);
+size_t store_read_since(const std::string& dir, int64_t since_ns, SampleWindow& out);
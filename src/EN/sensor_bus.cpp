@@ -0,0 +1,255 @@
+﻿#include "sensor_bus.h"
+#include "serial_engine.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+// Consecutive timeouts before a probe is considered offline
+#define OFFLINE_AFTER_FAILURES 3
+// Recovery probes start fast and back off exponentially up to the maximum
+#define RECOVERY_PROBE_MIN_MS 250
+#define RECOVERY_PROBE_MAX_MS 30000
+// Minimum time between port reopen attempts while every probe is offline
+#define RECONNECT_INTERVAL_MS 5000
+
+SensorBus& SensorBus::get_instance() {
+    static SensorBus instance;
+    return instance;
+}
+
+void SensorBus::add_sensor(int address, int period_ms, int priority, int timeout_ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (opened) return;
+
+    Slot slot;
+    slot.status.address = address;
+    slot.status.period_ms = std::max(period_ms, 1);
+    slot.priority = priority;
+    slot.timeout_ms = timeout_ms;
+    slots.push_back(slot);
+}
+
+void SensorBus::clear_sensors() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!opened) slots.clear();
+}
+
+bool SensorBus::attach_port() {
+    if (!init_serial_config(device.c_str(), &config)) return false;
+
+    // Half duplex: the next request may only go out after the previous one is answered or timed out
+    const SensorProtocol* p = protocol;
+    serial_engine().set_max_in_flight(1);
+    serial_engine().set_splitter([p](const uint8_t* buf, size_t len) { return p->split_frame(buf, len); });
+    return true;
+}
+
+bool SensorBus::open(const char* port, const serial_config_t& line) {
+    if (opened) close();
+    device = port;
+    config = line;
+    if (!attach_port()) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t now = monotonic_us();
+    for (auto& slot : slots) {
+        BusSensorStatus fresh;
+        fresh.address = slot.status.address;
+        fresh.period_ms = slot.status.period_ms;
+        slot.status = fresh;
+        slot.next_due_us = now;
+        slot.interval_ewma_ns = 0;
+    }
+    rr_cursor = 0;
+    busy = false;
+    last_reconnect_us = now;
+    reconnect_count.store(0);
+    opened = true;
+    return true;
+}
+
+void SensorBus::close() {
+    if (!opened) return;
+    close_serial();     // Fails the request in flight
+    std::lock_guard<std::mutex> lock(mutex);
+    busy = false;
+    opened = false;
+}
+
+// Called with the mutex held. Returns the slot index to poll next, or -1 if nothing is due.
+int SensorBus::pick_next(int64_t now) {
+    int best = -1;
+    size_t count = slots.size();
+
+    for (size_t n = 0; n < count; ++n) {
+        size_t i = (rr_cursor + n) % count;
+        const Slot& s = slots[i];
+        if (s.next_due_us > now) continue;
+
+        if (schedule == BusSchedule::RoundRobin) {
+            best = static_cast<int>(i);
+            break;
+        }
+        if (best < 0 || s.priority > slots[best].priority ||
+            (s.priority == slots[best].priority && s.next_due_us < slots[best].next_due_us))
+            best = static_cast<int>(i);
+    }
+
+    if (best >= 0) rr_cursor = (best + 1) % count;
+    return best;
+}
+
+// Called with the mutex held
+void SensorBus::on_failure(Slot& slot, bool timeout, int64_t now_us) {
+    BusSensorStatus& st = slot.status;
+    ++st.consecutive_failures;
+
+    // A garbled answer still shows the probe is alive, only silence takes it offline
+    if (!timeout || st.consecutive_failures < OFFLINE_AFTER_FAILURES) {
+        if (st.health == SensorHealth::Healthy) st.health = SensorHealth::Degraded;
+        return;
+    }
+
+    if (st.health != SensorHealth::Offline) {
+        st.health = SensorHealth::Offline;
+        st.retry_ms = RECOVERY_PROBE_MIN_MS;
+        fprintf(stderr, "Sensor %d offline after %d timeouts\n", st.address, st.consecutive_failures);
+    }
+    else {
+        st.retry_ms = std::min(st.retry_ms * 2, RECOVERY_PROBE_MAX_MS);
+    }
+    slot.next_due_us = now_us + st.retry_ms * 1000LL;
+}
+
+void SensorBus::on_response(size_t index, bool ok, const uint8_t* frame, size_t len) {
+    int64_t read_ns = monotonic_ns();   // The frame has just been completed by read()
+
+    std::lock_guard<std::mutex> lock(mutex);
+    busy = false;
+    if (index >= slots.size()) return;
+
+    Slot& slot = slots[index];
+    if (!ok) {
+        ++slot.status.timeouts;
+        on_failure(slot, true, read_ns / 1000);
+        return;
+    }
+
+    sensor_data_t data;
+    if (!protocol->parse_response(slot.status.address, frame, len, &data)) {
+        ++slot.status.bad_frames;
+        on_failure(slot, false, read_ns / 1000);
+        return;
+    }
+
+    if (slot.status.health == SensorHealth::Offline)
+        fprintf(stderr, "Sensor %d back online\n", slot.status.address);
+    slot.status.health = SensorHealth::Healthy;
+    slot.status.consecutive_failures = 0;
+    slot.status.retry_ms = 0;
+
+    if (slot.status.updated_ns) {
+        int64_t interval = read_ns - slot.status.updated_ns;
+        slot.interval_ewma_ns = slot.interval_ewma_ns
+            ? (slot.interval_ewma_ns * 7 + interval) / 8
+            : interval;
+        slot.status.rate_hz = slot.interval_ewma_ns ? 1e9 / slot.interval_ewma_ns : 0;
+    }
+    slot.status.latest = data;
+    slot.status.updated_ns = read_ns;
+    ++slot.status.responses;
+}
+
+// Reopens the port when it is gone or when no probe has answered for a while,
+// which recovers from USB adapters that were unplugged or wedged.
+void SensorBus::reconnect_if_needed(int64_t now_us) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (now_us - last_reconnect_us < RECONNECT_INTERVAL_MS * 1000LL) return;
+
+        bool all_offline = !slots.empty();
+        for (const auto& slot : slots)
+            all_offline = all_offline && slot.status.health == SensorHealth::Offline;
+        if (!all_offline && serial_engine().is_attached()) return;
+        last_reconnect_us = now_us;
+    }
+
+    fprintf(stderr, "Reopening %s\n", device.c_str());
+    close_serial();     // Fails the request in flight
+    ++reconnect_count;
+    if (!attach_port()) return;
+
+    // Probe every offline sensor right away; their backoff carries on if they stay silent
+    std::lock_guard<std::mutex> lock(mutex);
+    busy = false;
+    for (auto& slot : slots)
+        if (slot.status.health == SensorHealth::Offline) slot.next_due_us = now_us;
+}
+
+void SensorBus::run_until(int64_t deadline_us) {
+    SerialEngine& engine = serial_engine();
+
+    for (;;) {
+        int64_t now = monotonic_us();
+        if (now >= deadline_us || !opened) return;
+        reconnect_if_needed(now);
+        if (!engine.is_attached()) return;
+
+        int64_t wake_us = deadline_us;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!busy) {
+                int index = pick_next(now);
+                if (index >= 0) {
+                    Slot& slot = slots[index];
+                    // A probe that fell behind restarts its period instead of bursting to catch up
+                    int64_t period_us = slot.status.period_ms * 1000LL;
+                    slot.next_due_us += period_us;
+                    if (slot.next_due_us <= now) slot.next_due_us = now + period_us;
+                    ++slot.status.polls;
+
+                    uint8_t request[32];
+                    size_t len = protocol->build_request(slot.status.address, request, sizeof(request));
+                    size_t i = static_cast<size_t>(index);
+                    int address = slot.status.address;
+                    const SensorProtocol* p = protocol;
+                    busy = len && engine.submit(request, len, slot.timeout_ms,
+                        [this, i](bool ok, const uint8_t* frame, size_t n) { on_response(i, ok, frame, n); },
+                        [p, address](const uint8_t* frame, size_t n) { return p->from_address(address, frame, n); });
+                }
+                else {
+                    for (const auto& s : slots)
+                        wake_us = std::min(wake_us, s.next_due_us);
+                }
+            }
+        }
+
+        int wait_ms = static_cast<int>(std::max<int64_t>((wake_us - now + 999) / 1000, 0));
+        engine.run_once(wait_ms);
+    }
+}
+
+bool SensorBus::get_latest(int address, sensor_data_t& out, int64_t* updated_ns) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& slot : slots) {
+        if (slot.status.address != address) continue;
+        out = slot.status.latest;
+        if (updated_ns) *updated_ns = slot.status.updated_ns;
+        return slot.status.updated_ns != 0;
+    }
+    return false;
+}
+
+std::vector<BusSensorStatus> SensorBus::get_status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<BusSensorStatus> result;
+    result.reserve(slots.size());
+    for (const auto& slot : slots)
+        result.push_back(slot.status);
+    return result;
+}
+
+int SensorBus::primary_address() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slots.empty() ? 0 : slots.front().status.address;
+}
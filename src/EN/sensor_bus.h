@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include "serial_sensor.h"
+#include "sensor_protocol.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class BusSchedule {
+    RoundRobin,     // Due sensors take turns
+    Priority        // Highest priority due sensor first, ties by due time
+};
+
+enum class SensorHealth {
+    Healthy,        // Last request answered
+    Degraded,       // Recent timeout or bad frame, still polled at its normal period
+    Offline         // Several timeouts in a row, only probed with exponential backoff
+};
+
+// Snapshot of one addressed sensor on the bus
+struct BusSensorStatus {
+    int address = 0;
+    int period_ms = 0;          // Requested poll period
+    double rate_hz = 0;         // Measured response rate
+    sensor_data_t latest = { 0.0f, 0.0f, 0.0f };
+    int64_t updated_ns = 0;     // CLOCK_MONOTONIC when the last good response was read, 0 if none
+    uint64_t polls = 0;
+    uint64_t responses = 0;
+    uint64_t timeouts = 0;
+    uint64_t bad_frames = 0;    // Answered, but the frame did not decode (CRC, exception, garbage)
+    SensorHealth health = SensorHealth::Healthy;
+    int consecutive_failures = 0;
+    int retry_ms = 0;           // Offline: delay until the next recovery probe
+};
+
+// Owns the RS-485 port and schedules addressed poll requests for every probe on it.
+// The bus is half duplex, so exactly one request is in flight; each request has the
+// probe's own timeout, so a slow probe costs at most that long before the next turn.
+// A probe that stops answering is taken off the normal schedule and only probed with
+// exponential backoff; when every probe is offline the port itself is reopened.
+class SensorBus {
+public:
+    static SensorBus& get_instance();
+
+    // Sensors can only be changed while the bus is closed
+    void add_sensor(int address, int period_ms, int priority = 0, int timeout_ms = 200);
+    void clear_sensors();
+    void set_schedule(BusSchedule s) { schedule = s; }
+    void set_protocol(const SensorProtocol& p) { if (!opened) protocol = &p; }
+
+    bool open(const char* device, const serial_config_t& config);
+    void close();
+    bool is_open() const { return opened; }
+
+    // Issues due requests and handles responses until the monotonic deadline (microseconds)
+    void run_until(int64_t deadline_us);
+
+    // Thread safe, may be called from the LVGL thread
+    bool get_latest(int address, sensor_data_t& out, int64_t* updated_ns = nullptr) const;
+    std::vector<BusSensorStatus> get_status() const;
+    int primary_address() const;
+    uint64_t reconnects() const { return reconnect_count; }
+
+private:
+    struct Slot {
+        BusSensorStatus status;
+        int priority = 0;
+        int timeout_ms = 0;
+        int64_t next_due_us = 0;
+        int64_t interval_ewma_ns = 0;
+    };
+
+    int pick_next(int64_t now);
+    void on_response(size_t index, bool ok, const uint8_t* frame, size_t len);
+    void on_failure(Slot& slot, bool timeout, int64_t now_us);
+    bool attach_port();
+    void reconnect_if_needed(int64_t now_us);
+
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    BusSchedule schedule = BusSchedule::RoundRobin;
+    const SensorProtocol* protocol = &ascii_protocol();
+    size_t rr_cursor = 0;
+    bool busy = false;
+    bool opened = false;
+
+    std::string device;
+    serial_config_t config = {};
+    int64_t last_reconnect_us = 0;
+    std::atomic<uint64_t> reconnect_count{ 0 };
+
+    SensorBus() = default;
+    SensorBus(const SensorBus&) = delete;
+    SensorBus& operator=(const SensorBus&) = delete;
+};
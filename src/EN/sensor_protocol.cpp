@@ -0,0 +1,31 @@
+﻿#include "sensor_protocol.h"
+#include "serial_engine.h"
+#include "modbus_rtu.h"
+
+size_t AsciiProtocol::build_request(int address, uint8_t* buf, size_t size) const {
+    int len = format_poll2_request(address, reinterpret_cast<char*>(buf), size);
+    return (len > 0 && static_cast<size_t>(len) < size) ? static_cast<size_t>(len) : 0;
+}
+
+size_t AsciiProtocol::split_frame(const uint8_t* buf, size_t len) const {
+    return split_line_frame(buf, len);
+}
+
+bool AsciiProtocol::parse_response(int address, const uint8_t* frame, size_t len, sensor_data_t* out) const {
+    return from_address(address, frame, len) && parse_poll2_response(frame, len, out);
+}
+
+bool AsciiProtocol::from_address(int address, const uint8_t* frame, size_t len) const {
+    int responder = poll2_response_address(frame, len);
+    return responder < 0 || responder == address;
+}
+
+AsciiProtocol& ascii_protocol() {
+    static AsciiProtocol instance;
+    return instance;
+}
+
+SensorProtocol& find_protocol(const std::string& name) {
+    if (name == modbus_rtu_protocol().name()) return modbus_rtu_protocol();
+    return ascii_protocol();
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include "serial_sensor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Wire format used to poll one addressed sensor. SensorBus builds requests,
+// frames responses and decodes samples through this interface.
+class SensorProtocol {
+public:
+    virtual ~SensorProtocol() = default;
+
+    virtual const char* name() const = 0;
+
+    // Writes the poll request for the sensor into buf, returns its length (0 on error)
+    virtual size_t build_request(int address, uint8_t* buf, size_t size) const = 0;
+
+    // Returns the length of the first complete response frame in buf, 0 if more bytes are needed
+    virtual size_t split_frame(const uint8_t* buf, size_t len) const = 0;
+
+    virtual bool parse_response(int address, const uint8_t* frame, size_t len, sensor_data_t* out) const = 0;
+
+    // False if the frame names a different responder, i.e. it is a late answer to an earlier
+    // request. The bus drops such frames instead of counting them against the probe.
+    virtual bool from_address(int address, const uint8_t* frame, size_t len) const = 0;
+};
+
+// ASCII "<address> poll2" request answered by "<address>: <temp> <cond> <pres>\r\n".
+// Sensors that answer without the address prefix are still accepted, but their late
+// answers can only be caught by the input flush before each request.
+class AsciiProtocol : public SensorProtocol {
+public:
+    const char* name() const override { return "ASCII"; }
+    size_t build_request(int address, uint8_t* buf, size_t size) const override;
+    size_t split_frame(const uint8_t* buf, size_t len) const override;
+    bool parse_response(int address, const uint8_t* frame, size_t len, sensor_data_t* out) const override;
+    bool from_address(int address, const uint8_t* frame, size_t len) const override;
+};
+
+AsciiProtocol& ascii_protocol();
+
+// Returns the protocol registered under the given name (PROTOCOL= setting), ASCII if unknown
+SensorProtocol& find_protocol(const std::string& name);
@@ -1,13 +1,22 @@
-﻿#include "serial_sensor.h"
+﻿#include "sensor_recorder.h"
+#include "serial_sensor.h"
+#include "serial_engine.h"
+#include "sensor_bus.h"
+#include "modbus_rtu.h"
 #include "sensor_settings.h"
+#include "seqlock.h"
+#include "sample_ring.h"
+#include "sample_stats.h"
+#include "sample_committer.h"
+#include "periodic_timer.h"
+#include "sample_clock.h"
+#include "sensor_simulator.h"
 
-#include <fstream>
 #include <string>
 #include <chrono>
 #include <thread>
 #include <atomic>
 #include <ctime>
-#include <iomanip>
 #include <iostream>
 
 #ifndef _WIN32
@@ -18,10 +27,16 @@ static std::atomic<bool> is_recording(false);
 static std::atomic<bool> recorder_started(false);  // Used to avoid thread conflicts
 static std::thread recorder_thread;
 
+sensor_data_t get_latest_sensor_data() {
+    return get_latest_sensor_sample().data;
+}
+
 #ifdef _WIN32
 
-sensor_data_t get_latest_sensor_data() {
-    sensor_data_t data;
+sensor_sample_t get_latest_sensor_sample() {
+    static uint64_t seq = 0;
+    sensor_sample_t sample;
+    sensor_data_t& data = sample.data;
 
     static bool seeded = false;
     if (!seeded) {
@@ -33,22 +48,32 @@ sensor_data_t get_latest_sensor_data() {
     data.value2 = rand() % 100;
     data.value3 = rand() % 100;
 
-    return data;
+    sample.seq = ++seq;
+    sample.timestamp_ns = monotonic_ns();
+    return sample;
 }
 
-void start_sensor_recording(bool simulate, int interval_sec) {
+void start_sensor_recording(bool simulate, int interval_ms) {
     // No implementation needed for simulation mode
 }
 
 #else
 // Linux: Real sensor data
-static sensor_data_t latest_data;
+static SeqLock<sensor_sample_t> latest_sample;
+
+static void publish_sample(const sensor_data_t& data, int64_t timestamp_ns) {
+    sensor_sample_t sample;
+    sample.data = data;
+    sample.seq = latest_sample.version() + 1;
+    sample.timestamp_ns = timestamp_ns;
+    latest_sample.store(sample);
+}
 
-sensor_data_t get_latest_sensor_data() {
-    return latest_data;
+sensor_sample_t get_latest_sensor_sample() {
+    return latest_sample.load();
 }
 
-void start_sensor_recording(bool simulate, int interval_sec) {
+void start_sensor_recording(bool simulate, int interval_ms) {
 
     if (recorder_thread.joinable()) {
         recorder_thread.join();
@@ -59,11 +84,46 @@ void start_sensor_recording(bool simulate, int interval_sec) {
     is_recording.store(true);
     recorder_started.store(false);
 
-    recorder_thread = std::thread([simulate, interval_sec]() {
-        if (!simulate) {
-            // You must configure this part according to your sensor and device.
-            if (!init_serial("xxx", 11111)) {
+    recorder_thread = std::thread([simulate, interval_ms]() {
+        SensorBus& bus = SensorBus::get_instance();
+        SensorSimulator& sim = shared_simulator();
+        std::string device = serial_device;
+
+        if (simulate) {
+            SimulatorConfig sim_config = default_simulator_config();
+            sim_config.seed = simulation_seed;
+            sim_config.rate_hz = simulation_rate_hz;
+            sim_config.dropout_prob = simulation_dropout;
+            sim_config.fault_prob = simulation_fault;
+            sim.configure(sim_config);
+        }
+
+        // Direct simulation skips the serial port; the pty simulator goes through the real bus
+        const bool pty = simulate && simulation_pty && sim.start_pty();
+        const bool direct = simulate && !pty;
+        if (pty) device = sim.pty_path();
+
+        if (!direct) {
+            // Port, line settings and probes come from /etc/sensor_settings.txt
+            serial_config_t config = serial_default_config(serial_baudrate);
+            config.low_latency = serial_low_latency;
+
+            bus.clear_sensors();
+            for (const auto& cfg : bus_sensors)
+                bus.add_sensor(cfg.address, cfg.period_ms, cfg.priority);
+            if (bus_sensors.empty())
+                bus.add_sensor(1, interval_ms);
+            bus.set_schedule(bus_priority_schedule ? BusSchedule::Priority : BusSchedule::RoundRobin);
+
+            ModbusRtuProtocol& modbus = modbus_rtu_protocol();
+            modbus.set_start_register(static_cast<uint16_t>(modbus_start_register));
+            modbus.set_function(static_cast<uint8_t>(modbus_function));
+            modbus.set_word_swap(modbus_word_swap);
+            bus.set_protocol(find_protocol(sensor_protocol));
+
+            if (!bus.open(device.c_str(), config)) {
                 std::cerr << "[WARNING] Sensor is not connected.\n";
+                sim.stop_pty();
                 is_recording.store(false);
                 recorder_started.store(false);
                 return;
@@ -72,49 +132,91 @@ void start_sensor_recording(bool simulate, int interval_sec) {
 
         recorder_started.store(true);
 
-        std::ofstream logfile("/etc/sensor_data.txt", std::ios::app);
-        if (!logfile.is_open()) {
-            perror("Failed to open data file");
+        SampleStoreConfig store_config;
+        store_config.segment_bytes = static_cast<uint64_t>(std::max(log_segment_kb, 64)) << 10;
+        store_config.max_total_bytes = static_cast<uint64_t>(std::max(log_max_mb, 0)) << 20;
+        store_config.max_age_days = log_max_days;
+        if (log_compress == "1" || log_compress == "GZIP") store_config.compress = SegmentCodec::Gzip;
+        else if (log_compress == "GORILLA") store_config.compress = SegmentCodec::Gorilla;
+        if (log_durability == "FDATASYNC") store_config.durability = LogDurability::Fdatasync;
+        else if (log_durability == "DSYNC") store_config.durability = LogDurability::Dsync;
+
+        // Disk writes happen on the committer's thread, off the acquisition path
+        SampleCommitter log;
+        if (!log.start(store_config, log_batch, log_batch_ms)) {
             is_recording.store(false);
-            if (!simulate) close_serial();
+            if (!direct) bus.close();
+            sim.stop_pty();
             recorder_started.store(false);
             return;
         }
 
-        while (is_recording.load()) {
-            sensor_data_t data;
+        auto record = [&log](int64_t sample_ns, const sensor_data_t& data) {
+            // The log keeps wall-clock stamps so it stays meaningful across reboots
+            log.push(monotonic_to_realtime_ns(sample_ns), data);
 
-            if (simulate) {
-                data = simulatepoll2();
-            }
-            else {
-                data = getpoll2();
-            }
+            sample_ring().push(sample_ns, data);
+            sample_stats().add(sample_ns, data);
+            publish_sample(data, sample_ns);
+        };
 
-            if (data.value1 == 0.0f && data.value2 == 0.0f && data.value3 == 0.0f) {
-                std::this_thread::sleep_for(std::chrono::seconds(interval_sec));
+        int64_t last_update_ns = 0;
+        uint64_t next_sim_tick = direct ? sim.current_tick() : 0;
+        SampleWindow sim_batch;
+        PeriodicTimer timer(interval_ms);
+        timer.start();
+
+        while (is_recording.load()) {
+            // The bus keeps polling every probe while the recorder waits for its next tick
+            if (!direct) bus.run_until(timer.next_tick_ns() / 1000);
+            timer.wait_next();
+
+            if (direct) {
+                // Every simulator tick since the last wake-up, so SIM_RATE_HZ reaches the store and the UI
+                uint64_t end_tick = sim.current_tick();
+                sim_batch.clear();
+                sim.generate(next_sim_tick, end_tick, sim_batch);
+                next_sim_tick = end_tick;
+                for (size_t i = 0; i < sim_batch.size(); ++i)
+                    record(sim_batch.ts[i], { sim_batch.temp[i], sim_batch.cond[i], sim_batch.pres[i] });
                 continue;
             }
 
-            std::time_t now = std::time(nullptr);
-            char timestamp[32];
-            std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+            sensor_data_t data = { 0.0f, 0.0f, 0.0f };
+            int64_t sample_ns = 0;              // CLOCK_MONOTONIC at read completion
+            if (bus.get_latest(bus.primary_address(), data, &sample_ns) && sample_ns == last_update_ns)
+                data = { 0.0f, 0.0f, 0.0f };    // Nothing new since the last tick
+            last_update_ns = sample_ns;
 
-            logfile << std::fixed << std::setprecision(6);
-            logfile << timestamp;
-            if (show_temperature)  logfile << ", Temp: " << data.value1;
-            if (show_conductivity) logfile << ", Cond: " << data.value2;
-            if (show_pressure)     logfile << ", Pres: " << data.value3;
-            logfile << "\n";
-            logfile.flush();
-
-            latest_data = data;
-            std::this_thread::sleep_for(std::chrono::seconds(interval_sec));
+            if (data.value1 == 0.0f && data.value2 == 0.0f && data.value3 == 0.0f)
+                continue;
+            record(sample_ns, data);
         }
 
-        logfile.close();
-        if (!simulate)
-            close_serial();
+        log.stop();
+        const PeriodicTimer::Stats& ts = timer.stats();
+        std::cerr << "[INFO] Recorder ticks: " << ts.ticks << ", overruns: " << ts.overruns
+            << ", jitter avg/max (us): " << ts.jitter_avg_ns() / 1000 << "/" << ts.jitter_max_ns / 1000 << "\n";
+        const SampleCommitter::Stats cs = log.stats();
+        std::cerr << "[INFO] Log commits: " << cs.batches << ", samples: " << cs.samples << ", dropped: " << cs.dropped
+            << ", batch avg/max: " << cs.batch_avg() << "/" << cs.batch_max
+            << ", commit latency min/avg/max (us): " << cs.commit_min_us << "/"
+            << cs.commit_avg_us() << "/" << cs.commit_max_us << "\n";
+        if (!direct) {
+            const SerialEngine::Stats& st = serial_engine().stats();
+            std::cerr << "[INFO] Serial frames: " << st.frames << ", timeouts: " << st.timeouts
+                << ", latency min/avg/max (us): " << st.latency_min_us << "/"
+                << st.latency_avg_us() << "/" << st.latency_max_us << "\n";
+            for (const auto& s : bus.get_status())
+                std::cerr << "[INFO] Sensor " << s.address << ": polls " << s.polls << ", responses " << s.responses
+                << ", timeouts " << s.timeouts << ", bad frames " << s.bad_frames << "\n";
+            std::cerr << "[INFO] Port reconnects: " << bus.reconnects() << "\n";
+            bus.close();
+        }
+        if (simulate) {
+            std::cerr << "[INFO] Simulator requests served: " << sim.requests_served() << "\n";
+            sim.stop_pty();
+        }
 
         recorder_started.store(false);
         });
@@ -137,6 +239,6 @@ void stop_sensor_recording() {
     }
 
 #ifndef _WIN32
-    latest_data = { 0.0f, 0.0f, 0.0f };
+    publish_sample({ 0.0f, 0.0f, 0.0f }, monotonic_ns());   // Clears the Live Data screen
 #endif
 }
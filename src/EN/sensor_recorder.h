@@ -1,11 +1,19 @@
 ﻿#pragma once
 #include "serial_sensor.h"
+#include <cstdint>
 
+// Latest sample as published by the recorder thread
+struct sensor_sample_t {
+    sensor_data_t data;
+    uint64_t seq;           // Incremented on every publication, 0 = nothing published yet
+    int64_t timestamp_ns;   // CLOCK_MONOTONIC at publication
+};
 
-void start_sensor_recording(bool simulate, int interval_sec);
+
+void start_sensor_recording(bool simulate, int interval_ms);
 
 void stop_sensor_recording();
 
 bool is_sensor_recording();
 sensor_data_t get_latest_sensor_data();
-extern sensor_data_t latest_data;
+sensor_sample_t get_latest_sensor_sample();   // Never blocks the recorder thread
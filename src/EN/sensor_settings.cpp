@@ -7,6 +7,7 @@
 #include <fstream>
 #include <string>
 #include <cstdlib>
+#include <cstdio>
 
 // In this file, platform detection between Windows simulator and Linux device is done using IS_LINUX.
 // This is implemented to demonstrate an alternative approach.
@@ -17,12 +18,39 @@
 #   define IS_LINUX true
 #endif
 
+// Shortest recorder period accepted from the UI or the settings file
+static const int MIN_POLLING_INTERVAL_MS = 50;
+
 // Global variable definitions
 bool simulation_enabled = false;
-int  polling_interval_seconds = 10;
+int  polling_interval_ms = 10000;
 bool show_temperature = false;
 bool show_conductivity = false;
 bool show_pressure = false;
+// You must configure these according to your sensor and device.
+std::string serial_device = "/dev/ttyUSB0";
+int  serial_baudrate = 19200;
+bool serial_low_latency = true;
+std::string sensor_protocol = "ASCII";
+int  modbus_start_register = 0;
+int  modbus_function = 3;
+bool modbus_word_swap = false;
+std::vector<BusSensorConfig> bus_sensors;
+bool bus_priority_schedule = false;
+int  log_segment_kb = 4096;
+int  log_max_mb = 256;
+int  log_max_days = 0;
+std::string log_compress = "0";
+std::string log_durability = "NONE";
+int  log_batch = 32;
+int  log_batch_ms = 1000;
+std::string export_dir = "/media/usb";
+std::string export_format = "CSV";
+uint64_t simulation_seed = 1;
+int  simulation_rate_hz = 10;
+double simulation_dropout = 0.0;
+double simulation_fault = 0.0;
+bool simulation_pty = false;
 
 // Static UI objects
 static lv_obj_t* screen = nullptr;
@@ -41,7 +69,7 @@ static constexpr const char* settings_path = "/etc/sensor_settings.txt";
 static void start_data_collection_cb(lv_event_t* /*e*/) {
 #if !defined(_WIN32)
     stop_sensor_recording();
-    start_sensor_recording(simulation_enabled, polling_interval_seconds);
+    start_sensor_recording(simulation_enabled, polling_interval_ms);
 #endif
 }
 
@@ -58,14 +86,44 @@ static void load_settings() {
     std::ifstream file(settings_path);
     if (!file.is_open()) return;
 
+    bus_sensors.clear();
     std::string line;
     while (std::getline(file, line)) {
         if (line.rfind("SIM=", 0) == 0) simulation_enabled = (line.substr(4) == "1");
-        else if (line.rfind("INTERVAL=", 0) == 0) polling_interval_seconds = std::stoi(line.substr(9));
+        else if (line.rfind("INTERVAL_MS=", 0) == 0) polling_interval_ms = std::stoi(line.substr(12));
+        else if (line.rfind("INTERVAL=", 0) == 0) polling_interval_ms = std::stoi(line.substr(9)) * 1000;   // Older files, seconds
         else if (line.rfind("TEMP=", 0) == 0) show_temperature = (line.substr(5) == "1");
         else if (line.rfind("COND=", 0) == 0) show_conductivity = (line.substr(5) == "1");
         else if (line.rfind("PRESS=", 0) == 0) show_pressure = (line.substr(6) == "1");
+        else if (line.rfind("DEVICE=", 0) == 0) serial_device = line.substr(7);
+        else if (line.rfind("BAUD=", 0) == 0) serial_baudrate = std::stoi(line.substr(5));
+        else if (line.rfind("LOW_LATENCY=", 0) == 0) serial_low_latency = (line.substr(12) == "1");
+        else if (line.rfind("PROTOCOL=", 0) == 0) sensor_protocol = line.substr(9);
+        else if (line.rfind("MODBUS_REG=", 0) == 0) modbus_start_register = std::stoi(line.substr(11));
+        else if (line.rfind("MODBUS_FUNC=", 0) == 0) modbus_function = std::stoi(line.substr(12));
+        else if (line.rfind("MODBUS_WORDSWAP=", 0) == 0) modbus_word_swap = (line.substr(16) == "1");
+        else if (line.rfind("SCHEDULE=", 0) == 0) bus_priority_schedule = (line.substr(9) == "PRIORITY");
+        else if (line.rfind("SENSOR=", 0) == 0) {
+            BusSensorConfig cfg = { 1, 1000, 0 };
+            if (sscanf(line.c_str() + 7, "%d:%d:%d", &cfg.address, &cfg.period_ms, &cfg.priority) >= 1)
+                bus_sensors.push_back(cfg);
+        }
+        else if (line.rfind("LOG_SEGMENT_KB=", 0) == 0) log_segment_kb = std::stoi(line.substr(15));
+        else if (line.rfind("LOG_MAX_MB=", 0) == 0) log_max_mb = std::stoi(line.substr(11));
+        else if (line.rfind("LOG_MAX_DAYS=", 0) == 0) log_max_days = std::stoi(line.substr(13));
+        else if (line.rfind("LOG_COMPRESS=", 0) == 0) log_compress = line.substr(13);
+        else if (line.rfind("LOG_DURABILITY=", 0) == 0) log_durability = line.substr(15);
+        else if (line.rfind("LOG_BATCH=", 0) == 0) log_batch = std::stoi(line.substr(10));
+        else if (line.rfind("LOG_BATCH_MS=", 0) == 0) log_batch_ms = std::stoi(line.substr(13));
+        else if (line.rfind("EXPORT_DIR=", 0) == 0) export_dir = line.substr(11);
+        else if (line.rfind("EXPORT_FORMAT=", 0) == 0) export_format = line.substr(14);
+        else if (line.rfind("SIM_SEED=", 0) == 0) simulation_seed = std::stoull(line.substr(9));
+        else if (line.rfind("SIM_RATE_HZ=", 0) == 0) simulation_rate_hz = std::stoi(line.substr(12));
+        else if (line.rfind("SIM_DROPOUT=", 0) == 0) simulation_dropout = std::stod(line.substr(12));
+        else if (line.rfind("SIM_FAULT=", 0) == 0) simulation_fault = std::stod(line.substr(10));
+        else if (line.rfind("SIM_PTY=", 0) == 0) simulation_pty = (line.substr(8) == "1");
     }
+    if (polling_interval_ms < MIN_POLLING_INTERVAL_MS) polling_interval_ms = MIN_POLLING_INTERVAL_MS;
 }
 
 // Save settings to file (Linux only)
@@ -73,7 +131,8 @@ static void save_settings() {
     if (!IS_LINUX) return;
 
     simulation_enabled = lv_obj_has_state(sw_sim, LV_STATE_CHECKED);
-    polling_interval_seconds = std::atoi(lv_textarea_get_text(ta_poll));
+    polling_interval_ms = std::atoi(lv_textarea_get_text(ta_poll));
+    if (polling_interval_ms < MIN_POLLING_INTERVAL_MS) polling_interval_ms = MIN_POLLING_INTERVAL_MS;
     show_temperature = lv_obj_has_state(cb_temp, LV_STATE_CHECKED);
     show_conductivity = lv_obj_has_state(cb_cond, LV_STATE_CHECKED);
     show_pressure = lv_obj_has_state(cb_press, LV_STATE_CHECKED);
@@ -82,10 +141,34 @@ static void save_settings() {
     if (!file.is_open()) return;
 
     file << "SIM=" << (simulation_enabled ? "1" : "0") << '\n'
-        << "INTERVAL=" << polling_interval_seconds << '\n'
+        << "INTERVAL_MS=" << polling_interval_ms << '\n'
         << "TEMP=" << (show_temperature ? "1" : "0") << '\n'
         << "COND=" << (show_conductivity ? "1" : "0") << '\n'
-        << "PRESS=" << (show_pressure ? "1" : "0") << '\n';
+        << "PRESS=" << (show_pressure ? "1" : "0") << '\n'
+        << "DEVICE=" << serial_device << '\n'
+        << "BAUD=" << serial_baudrate << '\n'
+        << "LOW_LATENCY=" << (serial_low_latency ? "1" : "0") << '\n'
+        << "PROTOCOL=" << sensor_protocol << '\n'
+        << "MODBUS_REG=" << modbus_start_register << '\n'
+        << "MODBUS_FUNC=" << modbus_function << '\n'
+        << "MODBUS_WORDSWAP=" << (modbus_word_swap ? "1" : "0") << '\n'
+        << "SCHEDULE=" << (bus_priority_schedule ? "PRIORITY" : "RR") << '\n'
+        << "LOG_SEGMENT_KB=" << log_segment_kb << '\n'
+        << "LOG_MAX_MB=" << log_max_mb << '\n'
+        << "LOG_MAX_DAYS=" << log_max_days << '\n'
+        << "LOG_COMPRESS=" << log_compress << '\n'
+        << "LOG_DURABILITY=" << log_durability << '\n'
+        << "LOG_BATCH=" << log_batch << '\n'
+        << "LOG_BATCH_MS=" << log_batch_ms << '\n'
+        << "EXPORT_DIR=" << export_dir << '\n'
+        << "EXPORT_FORMAT=" << export_format << '\n'
+        << "SIM_SEED=" << simulation_seed << '\n'
+        << "SIM_RATE_HZ=" << simulation_rate_hz << '\n'
+        << "SIM_DROPOUT=" << simulation_dropout << '\n'
+        << "SIM_FAULT=" << simulation_fault << '\n'
+        << "SIM_PTY=" << (simulation_pty ? "1" : "0") << '\n';
+    for (const auto& cfg : bus_sensors)
+        file << "SENSOR=" << cfg.address << ':' << cfg.period_ms << ':' << cfg.priority << '\n';
 }
 
 // Show on-screen numeric keyboard for polling interval input
@@ -137,13 +220,13 @@ void create_sensor_settings_screen() {
     lv_obj_align(sw_sim, LV_ALIGN_CENTER, 60, -72);
 
     lv_obj_t* label_poll = lv_label_create(screen);
-    lv_label_set_text(label_poll, "Polling Interval (s):");
+    lv_label_set_text(label_poll, "Polling Interval (ms):");
     lv_obj_add_style(label_poll, &style_label_white, 0);
     lv_obj_align(label_poll, LV_ALIGN_CENTER, -80, -20);
 
     ta_poll = lv_textarea_create(screen);
     lv_obj_set_size(ta_poll, 80, 35);
-    lv_textarea_set_text(ta_poll, std::to_string(polling_interval_seconds).c_str());
+    lv_textarea_set_text(ta_poll, std::to_string(polling_interval_ms).c_str());
     lv_obj_add_event_cb(ta_poll, ta_event_cb, LV_EVENT_FOCUSED, nullptr);
     lv_obj_align(ta_poll, LV_ALIGN_CENTER, 60, -22);
 
@@ -1,13 +1,58 @@
 ﻿#pragma once
 
 #include "lvgl/lvgl.h"
+#include <cstdint>
+#include <string>
+#include <vector>
 
 //–– Uygulama içinde bir-kere tanımlanacak değişkenlerin bildirimleri ––//
 extern bool simulation_enabled;
-extern int  polling_interval_seconds;
+extern int  polling_interval_ms;      // Recorder period, 50 ms and up
 extern bool show_temperature;
 extern bool show_conductivity;
 extern bool show_pressure;
 
+// Serial line profile (file only, no UI)
+extern std::string serial_device;
+extern int  serial_baudrate;
+extern bool serial_low_latency;
+
+// Wire protocol: "ASCII" (poll2 text) or "MODBUS" (RTU, six registers from modbus_start_register)
+extern std::string sensor_protocol;
+extern int  modbus_start_register;
+extern int  modbus_function;
+extern bool modbus_word_swap;
+
+// Addressed probes on the RS-485 bus, one "SENSOR=address:period_ms:priority" line each.
+// The first entry is the one that is recorded and shown on the Live Data screen.
+struct BusSensorConfig {
+    int address;
+    int period_ms;
+    int priority;
+};
+extern std::vector<BusSensorConfig> bus_sensors;
+extern bool bus_priority_schedule;
+
+// Sample log segments: size, retention by total size and age, gzip of closed segments
+extern int  log_segment_kb;
+extern int  log_max_mb;
+extern int  log_max_days;
+extern std::string log_compress;         // "0", "GZIP" (or "1") or "GORILLA"
+extern std::string log_durability;      // "NONE", "FDATASYNC" or "DSYNC"
+extern int  log_batch;                  // Samples per group commit
+extern int  log_batch_ms;               // Longest a sample waits for its commit
+
+// Export from the Average Data screen: target directory (e.g. a mounted USB stick), "CSV" or "JSONL"
+extern std::string export_dir;
+extern std::string export_format;
+
+// Simulated probe (SIM=1). With SIM_PTY=1 it answers on a pseudo terminal and the
+// recorder reads it through the real serial/bus path instead of calling it directly.
+extern uint64_t simulation_seed;
+extern int  simulation_rate_hz;
+extern double simulation_dropout;
+extern double simulation_fault;
+extern bool simulation_pty;
+
 // Ekranı oluşturan API
 void create_sensor_settings_screen();
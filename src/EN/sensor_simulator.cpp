@@ -0,0 +1,356 @@
+﻿#include "sensor_simulator.h"
+#include "serial_engine.h"
+#include "modbus_rtu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#endif
+
+static const double PI = 3.14159265358979323846;
+
+// Longest gap that is generated tick by tick; beyond it the stream is re-derived from the tick index
+static const uint64_t MAX_CATCH_UP_TICKS = 100000;
+
+// ------------------
+// xoshiro256**
+// ------------------
+
+static uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+void Xoshiro256::reseed(uint64_t seed) {
+    for (auto& word : s) word = splitmix64(seed);
+}
+
+uint64_t Xoshiro256::next() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+double Xoshiro256::uniform() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);     // 53 random bits
+}
+
+double Xoshiro256::normal() {
+    double u1 = uniform();
+    double u2 = uniform();
+    if (u1 < 1e-300) u1 = 1e-300;
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * PI * u2);
+}
+
+// ------------------
+// Probe model
+// ------------------
+
+SimulatorConfig default_simulator_config() {
+    SimulatorConfig c;
+    c.temp = { Waveform::Sine, 19.5f, 0.5f, 300.0f, 0.02f };
+    c.cond = { Waveform::RandomWalk, 30.7f, 0.2f, 600.0f, 0.01f };
+    c.pres = { Waveform::Sine, -0.000010f, 0.000005f, 120.0f, 0.000001f };
+    return c;
+}
+
+SensorSimulator::SensorSimulator(const SimulatorConfig& config) {
+    configure(config);
+}
+
+SensorSimulator::~SensorSimulator() {
+    stop_pty();
+}
+
+void SensorSimulator::configure(const SimulatorConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    cfg = config;
+    if (cfg.rate_hz < 1) cfg.rate_hz = 1;
+    if (cfg.rate_hz > 10000) cfg.rate_hz = 10000;
+    rng.reseed(cfg.seed);
+    next_tick = 0;
+    current = Tick{};
+    walk[0] = walk[1] = walk[2] = 0.0f;
+    start_ns = monotonic_ns();
+}
+
+float SensorSimulator::channel_value(const ChannelModel& m, double t_s, float walk_value) {
+    double phase = m.period_s > 0 ? t_s / m.period_s : 0.0;
+    double frac = phase - std::floor(phase);
+    double shape = 0.0;
+
+    switch (m.shape) {
+    case Waveform::Constant:   shape = 0.0; break;
+    case Waveform::Sine:       shape = std::sin(2.0 * PI * phase); break;
+    case Waveform::Square:     shape = frac < 0.5 ? 1.0 : -1.0; break;
+    case Waveform::Sawtooth:   shape = 2.0 * frac - 1.0; break;
+    case Waveform::RandomWalk: shape = walk_value; break;
+    }
+    return static_cast<float>(m.base + m.amplitude * shape);
+}
+
+SensorSimulator::Tick SensorSimulator::tick_at(uint64_t index) {
+    if (index + 1 < next_tick) return current;      // Time does not run backwards, hold the last tick
+
+    if (index >= next_tick && index - next_tick > MAX_CATCH_UP_TICKS) {
+        rng.reseed(cfg.seed ^ (index * 0x9E3779B97F4A7C15ULL));
+        next_tick = index;
+    }
+
+    const ChannelModel* models[3] = { &cfg.temp, &cfg.cond, &cfg.pres };
+    double dt = 1.0 / cfg.rate_hz;
+
+    while (next_tick <= index) {
+        double t = next_tick * dt;
+        float values[3];
+
+        for (int c = 0; c < 3; ++c) {
+            const ChannelModel& m = *models[c];
+            if (m.shape == Waveform::RandomWalk) {
+                // Unit-variance walk over one period, pulled back towards zero so it stays bounded
+                double step = m.period_s > 0 ? std::sqrt(dt / m.period_s) : 0.0;
+                walk[c] = static_cast<float>(walk[c] * (1.0 - step * step) + step * rng.normal());
+            }
+            values[c] = channel_value(m, t, walk[c]) + static_cast<float>(m.noise * rng.normal());
+        }
+
+        Tick tick;
+        tick.data = { values[0], values[1], values[2] };
+        tick.dropout = rng.uniform() < cfg.dropout_prob;
+        tick.fault = Fault::None;
+
+        if (rng.uniform() < cfg.fault_prob) {
+            switch (rng.next() % 3) {
+            case 0:
+                tick.fault = Fault::Spike;
+                tick.data.value1 *= 10.0f;
+                break;
+            case 1:
+                tick.fault = Fault::NaN;
+                tick.data.value2 = std::numeric_limits<float>::quiet_NaN();
+                break;
+            default:
+                tick.fault = Fault::Corrupt;
+                break;
+            }
+        }
+
+        current = tick;
+        ++next_tick;
+    }
+    return current;
+}
+
+uint64_t SensorSimulator::current_tick() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<uint64_t>(std::max<int64_t>(monotonic_ns() - start_ns, 0) * cfg.rate_hz / 1000000000LL);
+}
+
+int64_t SensorSimulator::tick_time_ns(uint64_t index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return start_ns + static_cast<int64_t>(index * 1000000000ULL / static_cast<uint64_t>(cfg.rate_hz));
+}
+
+size_t SensorSimulator::generate(uint64_t first_tick, uint64_t end_tick, SampleWindow& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // A consumer that fell far behind resumes at the recent ticks
+    if (end_tick > first_tick + MAX_CATCH_UP_TICKS) first_tick = end_tick - MAX_CATCH_UP_TICKS;
+
+    size_t added = 0;
+    for (uint64_t i = first_tick; i < end_tick; ++i) {
+        Tick tick = tick_at(i);
+        if (tick.dropout) continue;
+        out.ts.push_back(start_ns + static_cast<int64_t>(i * 1000000000ULL / static_cast<uint64_t>(cfg.rate_hz)));
+        out.temp.push_back(tick.data.value1);
+        out.cond.push_back(tick.data.value2);
+        out.pres.push_back(tick.data.value3);
+        ++added;
+    }
+    return added;
+}
+
+// ------------------
+// Fake serial device
+// ------------------
+
+#ifndef _WIN32
+
+bool SensorSimulator::start_pty() {
+    stop_pty();
+
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+        perror("Failed to create simulator pty");
+        if (master_fd >= 0) close(master_fd);
+        master_fd = -1;
+        return false;
+    }
+
+    slave_path = ptsname(master_fd);
+
+    // Raw on both ends, the acquisition side configures the slave again in init_serial_config()
+    struct termios tty;
+    if (tcgetattr(master_fd, &tty) == 0) {
+        cfmakeraw(&tty);
+        tcsetattr(master_fd, TCSANOW, &tty);
+    }
+
+    pty_running.store(true);
+    pty_thread = std::thread([this] { pty_loop(); });
+    return true;
+}
+
+void SensorSimulator::stop_pty() {
+    pty_running.store(false);
+    if (pty_thread.joinable()) pty_thread.join();
+    if (master_fd >= 0) close(master_fd);
+    master_fd = -1;
+    slave_path.clear();
+}
+
+// Writes the whole answer, waiting out short writes and a full pty buffer. False if the
+// pty failed (e.g. EIO while no one has the slave open); the answer is then lost, as on a real bus.
+static bool write_all(int fd, const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                struct pollfd pfd = { fd, POLLOUT, 0 };
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void SensorSimulator::pty_loop() {
+    std::string rx;
+
+    while (pty_running.load()) {
+        struct pollfd pfd = { master_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) <= 0) continue;
+
+        char buf[256];
+        ssize_t n = read(master_fd, buf, sizeof(buf));
+        if (n <= 0) {
+            usleep(10000);      // Slave side not opened yet
+            continue;
+        }
+        rx.append(buf, n);
+
+        for (;;) {
+            int address = 0;
+            bool modbus = false;
+            uint8_t function = 0;
+
+            if (rx.empty()) break;
+            if (rx[0] >= '0' && rx[0] <= '9') {
+                size_t nl = rx.find('\n');
+                if (nl == std::string::npos) break;
+                address = atoi(rx.c_str());
+                bool is_poll2 = rx.compare(0, nl, std::to_string(address) + " poll2\r") == 0
+                    || rx.compare(0, nl, std::to_string(address) + " poll2") == 0;
+                rx.erase(0, nl + 1);
+                if (!is_poll2) continue;
+            }
+            else {
+                if (rx.size() < 8) break;
+                const uint8_t* f = reinterpret_cast<const uint8_t*>(rx.data());
+                if (modbus_crc16(f, 6) != static_cast<uint16_t>(f[6] | (f[7] << 8))) {
+                    rx.erase(0, 1);     // Resynchronise byte by byte
+                    continue;
+                }
+                address = f[0];
+                function = f[1];
+                modbus = true;
+                rx.erase(0, 8);
+            }
+
+            sensor_data_t d;
+            Tick tick;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                double t = (monotonic_ns() - start_ns) / 1e9;
+                tick = tick_at(static_cast<uint64_t>(t * cfg.rate_hz));
+            }
+            if (tick.dropout) continue;
+            d = tick.data;
+
+            if (cfg.response_delay_ms > 0) usleep(cfg.response_delay_ms * 1000);
+
+            if (modbus) {
+                uint8_t frame[17] = { static_cast<uint8_t>(address), function, 12 };
+                float values[3] = { d.value1, d.value2, d.value3 };
+                for (int i = 0; i < 3; ++i) {
+                    uint32_t bits;
+                    memcpy(&bits, &values[i], sizeof(bits));
+                    frame[3 + i * 4] = static_cast<uint8_t>(bits >> 24);
+                    frame[4 + i * 4] = static_cast<uint8_t>(bits >> 16);
+                    frame[5 + i * 4] = static_cast<uint8_t>(bits >> 8);
+                    frame[6 + i * 4] = static_cast<uint8_t>(bits);
+                }
+                uint16_t crc = modbus_crc16(frame, 15);
+                frame[15] = static_cast<uint8_t>(crc & 0xFF);
+                frame[16] = static_cast<uint8_t>(crc >> 8);
+                if (tick.fault == Fault::Corrupt) frame[16] ^= 0x5A;
+                if (!write_all(master_fd, frame, sizeof(frame))) {
+                    perror("Simulator pty write error");
+                    continue;
+                }
+            }
+            else {
+                char line[96];
+                int len = tick.fault == Fault::Corrupt
+                    ? snprintf(line, sizeof(line), "#?ERR %d\r\n", address)
+                    : snprintf(line, sizeof(line), "%d: %f %f %f\r\n", address, d.value1, d.value2, d.value3);
+                if (!write_all(master_fd, line, static_cast<size_t>(len))) {
+                    perror("Simulator pty write error");
+                    continue;
+                }
+            }
+            served.fetch_add(1);
+        }
+    }
+}
+
+#else
+
+bool SensorSimulator::start_pty() { return false; }
+void SensorSimulator::stop_pty() {}
+void SensorSimulator::pty_loop() {}
+
+#endif
+
+SensorSimulator& shared_simulator() {
+    static SensorSimulator instance;
+    return instance;
+}
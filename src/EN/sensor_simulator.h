@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include "serial_sensor.h"
+#include "sample_ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// xoshiro256** PRNG, seeded through splitmix64 so any 64-bit seed is usable
+class Xoshiro256 {
+public:
+    explicit Xoshiro256(uint64_t seed = 1) { reseed(seed); }
+
+    void reseed(uint64_t seed);
+    uint64_t next();
+    double uniform();               // [0, 1)
+    double normal();                // Standard normal (Box-Muller)
+
+private:
+    uint64_t s[4];
+};
+
+enum class Waveform { Constant, Sine, Square, Sawtooth, RandomWalk };
+
+struct ChannelModel {
+    Waveform shape = Waveform::Sine;
+    float base = 0.0f;
+    float amplitude = 0.0f;
+    float period_s = 60.0f;
+    float noise = 0.0f;             // Standard deviation of the added Gaussian noise
+};
+
+struct SimulatorConfig {
+    uint64_t seed = 1;
+    int rate_hz = 10;               // Internal update rate of the simulated probe, up to 10 kHz
+    ChannelModel temp;
+    ChannelModel cond;
+    ChannelModel pres;
+    double dropout_prob = 0.0;      // Tick without a sample (probe does not answer)
+    double fault_prob = 0.0;        // Tick with a spike, NaN or, on the pty, a corrupted frame
+    int response_delay_ms = 2;      // pty mode: turnaround before the answer is written
+};
+
+SimulatorConfig default_simulator_config();
+
+// Deterministic probe model. Values are a function of the tick index
+// (time * rate_hz) and the seed, so a run can be reproduced exactly.
+class SensorSimulator {
+public:
+    explicit SensorSimulator(const SimulatorConfig& config = default_simulator_config());
+    ~SensorSimulator();
+
+    // Restarts the model (tick 0, fresh PRNG stream) with new settings
+    void configure(const SimulatorConfig& config);
+    const SimulatorConfig& config() const { return cfg; }
+
+    // Index of the tick that contains the current monotonic time, and the CLOCK_MONOTONIC start of a tick
+    uint64_t current_tick();
+    int64_t tick_time_ns(uint64_t index);
+
+    // Appends ticks [first_tick, end_tick) to `out`, stamped with tick_time_ns() and
+    // without the dropouts. In direct mode (SIM=1 without SIM_PTY) the recorder takes
+    // every tick that came due since its last wake-up, so it records at the full rate.
+    size_t generate(uint64_t first_tick, uint64_t end_tick, SampleWindow& out);
+
+    // Serves the ASCII poll2 and Modbus-RTU protocols on a pseudo terminal, so the
+    // real acquisition path can run against it. Returns the slave device path.
+    bool start_pty();
+    void stop_pty();
+    std::string pty_path() const { return slave_path; }
+
+    uint64_t requests_served() const { return served.load(); }
+
+private:
+    enum class Fault { None, Spike, NaN, Corrupt };
+
+    struct Tick {
+        sensor_data_t data;
+        bool dropout;
+        Fault fault;
+    };
+
+    Tick tick_at(uint64_t index);       // Called with the mutex held
+    float channel_value(const ChannelModel& m, double t_s, float walk);
+    void pty_loop();
+
+    std::mutex mutex;
+    SimulatorConfig cfg;
+    Xoshiro256 rng;
+    uint64_t next_tick = 0;         // Ticks are generated in order so the PRNG stream is reproducible
+    Tick current{};
+    float walk[3] = { 0.0f, 0.0f, 0.0f };
+    int64_t start_ns = 0;
+
+    int master_fd = -1;
+    std::string slave_path;
+    std::thread pty_thread;
+    std::atomic<bool> pty_running{ false };
+    std::atomic<uint64_t> served{ 0 };
+};
+
+// Simulator the recorder runs against with SIM=1
+SensorSimulator& shared_simulator();
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer sequence lock for small trivially copyable values.
+// The writer never waits; readers retry if a write overlapped their copy.
+// The payload is kept in relaxed atomic words so the racing copy is well defined.
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+public:
+    SeqLock() {
+        for (auto& w : words) w.store(0, std::memory_order_relaxed);
+    }
+
+    void store(const T& value) {
+        uint64_t buf[WORDS] = {};
+        memcpy(buf, &value, sizeof(T));
+
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);        // Odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; ++i)
+            words[i].store(buf[i], std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t buf[WORDS];
+        uint32_t s1, s2;
+        do {
+            s1 = seq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; ++i)
+                buf[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s2 = seq.load(std::memory_order_relaxed);
+        } while ((s1 & 1) || s1 != s2);
+
+        T value;
+        memcpy(&value, buf, sizeof(T));
+        return value;
+    }
+
+    // Number of completed writes, cheap way for readers to detect a change
+    uint32_t version() const { return seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> seq{ 0 };
+    std::atomic<uint64_t> words[WORDS];
+};
@@ -0,0 +1,229 @@
+﻿#include "serial_engine.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#endif
+
+int64_t monotonic_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t monotonic_ns() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+size_t split_line_frame(const uint8_t* buf, size_t len) {
+    const void* nl = memchr(buf, '\n', len);
+    return nl ? static_cast<const uint8_t*>(nl) - buf + 1 : 0;
+}
+
+SerialEngine::SerialEngine(FrameSplitter splitter) : splitter(std::move(splitter)) {}
+
+bool SerialEngine::submit(const void* req, size_t len, int timeout_ms, Completion done, FrameFilter accept) {
+    if (fd < 0) return false;
+
+    Request r;
+    r.bytes.assign(static_cast<const uint8_t*>(req), static_cast<const uint8_t*>(req) + len);
+    r.timeout_ms = timeout_ms;
+    r.done = std::move(done);
+    r.accept = std::move(accept);
+    queue.push_back(std::move(r));
+    return true;
+}
+
+void SerialEngine::complete_front(bool ok, const uint8_t* frame, size_t len) {
+    Request r = std::move(queue.front());
+    queue.pop_front();
+    latency_us = monotonic_us() - r.sent_us;
+    ++completed;
+
+    if (ok) {
+        if (counters.frames == 0 || latency_us < counters.latency_min_us) counters.latency_min_us = latency_us;
+        if (latency_us > counters.latency_max_us) counters.latency_max_us = latency_us;
+        counters.latency_sum_us += latency_us;
+        ++counters.frames;
+    }
+    else if (r.deadline_us) {
+        ++counters.timeouts;
+    }
+    if (r.done) r.done(ok, frame, len);
+}
+
+void SerialEngine::drain() {
+    while (fd >= 0 && !queue.empty())
+        run_once(1000);
+}
+
+bool SerialEngine::transact(const void* req, size_t len, int timeout_ms, std::vector<uint8_t>& response) {
+    bool result = false;
+    bool finished = false;
+    bool queued = submit(req, len, timeout_ms, [&](bool ok, const uint8_t* frame, size_t n) {
+        result = ok;
+        finished = true;
+        if (ok) response.assign(frame, frame + n);
+        });
+    if (!queued) return false;
+
+    while (!finished && fd >= 0)
+        run_once(timeout_ms);
+    return result;
+}
+
+#ifndef _WIN32
+
+void SerialEngine::attach(int new_fd) {
+    detach();
+    fd = new_fd;
+    if (fd < 0) return;
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    rx.clear();
+    counters = Stats();
+}
+
+void SerialEngine::detach() {
+    while (!queue.empty())
+        complete_front(false, nullptr, 0);
+    rx.clear();
+    fd = -1;
+}
+
+// Nothing is in flight, so anything still in the input is a late answer to an expired request
+void SerialEngine::discard_input() {
+    uint8_t buf[256];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        counters.stale_bytes += n;
+    tcflush(fd, TCIFLUSH);      // Fails harmlessly on pipes and sockets
+    counters.stale_bytes += rx.size();
+    rx.clear();
+}
+
+// Writes the requests that fit into the pipeline. Returns true if a write is still pending.
+bool SerialEngine::flush_writes() {
+    size_t index = 0;
+    for (auto& r : queue) {
+        if (index++ >= max_in_flight) break;
+        if (r.deadline_us) continue;
+        if (index == 1 && r.written == 0) discard_input();
+
+        while (r.written < r.bytes.size()) {
+            ssize_t n = write(fd, r.bytes.data() + r.written, r.bytes.size() - r.written);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) return true;
+                perror("Serial write error");
+                r.sent_us = monotonic_us();
+                r.deadline_us = r.sent_us;  // Expires on the next deadline check
+                return false;
+            }
+            r.written += n;
+        }
+        r.sent_us = monotonic_us();
+        r.deadline_us = r.sent_us + static_cast<int64_t>(r.timeout_ms) * 1000;
+    }
+    return false;
+}
+
+void SerialEngine::read_available() {
+    uint8_t buf[256];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        rx.insert(rx.end(), buf, buf + n);
+    }
+
+    size_t consumed = 0;
+    while (consumed < rx.size()) {
+        size_t frame = splitter(rx.data() + consumed, rx.size() - consumed);
+        if (frame == 0) break;
+
+        // Frames that nobody waits for, or that the request rejects, are late answers to
+        // expired requests and are dropped
+        const uint8_t* f = rx.data() + consumed;
+        if (!queue.empty() && queue.front().deadline_us) {
+            const Request& r = queue.front();
+            if (!r.accept || r.accept(f, frame)) complete_front(true, f, frame);
+            else ++counters.stray_frames;
+        }
+        consumed += frame;
+    }
+    rx.erase(rx.begin(), rx.begin() + consumed);
+}
+
+int SerialEngine::expire_deadlines(int64_t now) {
+    int wait_ms = -1;
+    while (!queue.empty() && queue.front().deadline_us) {
+        int64_t left = queue.front().deadline_us - now;
+        if (left > 0) {
+            wait_ms = static_cast<int>((left + 999) / 1000);
+            break;
+        }
+        // Partial bytes belong to the expired response, resynchronise on the next frame
+        rx.clear();
+        complete_front(false, nullptr, 0);
+    }
+    return wait_ms;
+}
+
+int SerialEngine::run_once(int max_wait_ms) {
+    if (fd < 0) return 0;
+    completed = 0;
+
+    bool want_write = flush_writes();
+    int wait_ms = expire_deadlines(monotonic_us());
+    if (completed) return completed;
+    if (queue.empty() && max_wait_ms < 0) return 0;
+    if (wait_ms < 0 || (max_wait_ms >= 0 && max_wait_ms < wait_ms))
+        wait_ms = max_wait_ms;
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN | (want_write ? POLLOUT : 0);
+    pfd.revents = 0;
+
+    int ret = poll(&pfd, 1, wait_ms);
+    if (ret < 0 && errno != EINTR) {
+        perror("poll error");
+        return 0;
+    }
+
+    if (ret > 0) {
+        if (pfd.revents & (POLLIN | POLLERR | POLLHUP)) read_available();
+        if (pfd.revents & POLLOUT) flush_writes();
+    }
+    expire_deadlines(monotonic_us());
+    flush_writes();
+    return completed;
+}
+
+#else
+
+// Windows simulator has no serial port, every request fails immediately
+void SerialEngine::attach(int new_fd) { fd = new_fd; }
+void SerialEngine::detach() {
+    while (!queue.empty())
+        complete_front(false, nullptr, 0);
+    fd = -1;
+}
+bool SerialEngine::flush_writes() { return false; }
+void SerialEngine::read_available() {}
+int SerialEngine::expire_deadlines(int64_t) { return -1; }
+int SerialEngine::run_once(int) {
+    completed = 0;
+    while (!queue.empty())
+        complete_front(false, nullptr, 0);
+    return completed;
+}
+
+#endif
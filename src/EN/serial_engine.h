@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Returns the length of the first complete frame in buf, or 0 if more bytes are needed.
+using FrameSplitter = std::function<size_t(const uint8_t* buf, size_t len)>;
+
+// False for a frame that cannot be the answer to the request in flight (e.g. a late
+// answer from another responder); such frames are dropped and the request keeps waiting.
+using FrameFilter = std::function<bool(const uint8_t* frame, size_t len)>;
+
+// CLOCK_MONOTONIC, used for deadlines, scheduling and sample timestamps
+int64_t monotonic_us();
+int64_t monotonic_ns();
+
+// Default splitter for the ASCII sensor protocol: a frame ends with '\n'.
+size_t split_line_frame(const uint8_t* buf, size_t len);
+
+// Event-driven request/response engine on top of a serial file descriptor.
+// Requests are written as soon as the pipeline has room, responses are framed
+// from readiness on the fd (poll) and matched to requests in FIFO order.
+// Every request carries its own deadline instead of a fixed sleep. Input left over
+// when a request goes out on an idle line is discarded, so an answer that missed its
+// deadline cannot be taken for the answer to the next request.
+class SerialEngine {
+public:
+    using Completion = std::function<void(bool ok, const uint8_t* frame, size_t len)>;
+
+    // Per-frame latency, measured from the end of the request write to the last byte of the response
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t timeouts = 0;
+        uint64_t stray_frames = 0;      // Rejected by the request's filter
+        uint64_t stale_bytes = 0;       // Discarded before a request was written
+        int64_t latency_min_us = 0;
+        int64_t latency_max_us = 0;
+        int64_t latency_sum_us = 0;
+
+        int64_t latency_avg_us() const { return frames ? latency_sum_us / static_cast<int64_t>(frames) : 0; }
+    };
+
+    explicit SerialEngine(FrameSplitter splitter = split_line_frame);
+
+    void attach(int fd);                // Takes the fd into non-blocking mode, does not own it
+    void detach();                      // Fails all pending requests
+    bool is_attached() const { return fd >= 0; }
+
+    void set_splitter(FrameSplitter s) { splitter = std::move(s); }
+    void set_max_in_flight(size_t n) { max_in_flight = n ? n : 1; }
+
+    // Queues a request; the completion runs from run_once() on the caller's thread
+    bool submit(const void* req, size_t len, int timeout_ms, Completion done, FrameFilter accept = nullptr);
+
+    // Writes queued requests, waits for readiness up to max_wait_ms (or the next
+    // deadline) and dispatches completions. Returns the number of completions.
+    int run_once(int max_wait_ms);
+
+    // Drives the engine until all queued requests are completed
+    void drain();
+
+    // Blocking convenience wrapper for a single request
+    bool transact(const void* req, size_t len, int timeout_ms, std::vector<uint8_t>& response);
+
+    size_t pending() const { return queue.size(); }
+
+    // Latency of the last completed request (microseconds)
+    int64_t last_latency_us() const { return latency_us; }
+    const Stats& stats() const { return counters; }
+    void reset_stats() { counters = Stats(); }
+
+private:
+    struct Request {
+        std::vector<uint8_t> bytes;
+        size_t written = 0;
+        int timeout_ms = 0;
+        int64_t sent_us = 0;            // Monotonic time when the last byte was written
+        int64_t deadline_us = 0;        // 0 until the request is fully written
+        Completion done;
+        FrameFilter accept;
+    };
+
+    bool flush_writes();
+    void discard_input();
+    void read_available();
+    void complete_front(bool ok, const uint8_t* frame, size_t len);
+    int expire_deadlines(int64_t now);
+
+    int fd = -1;
+    FrameSplitter splitter;
+    size_t max_in_flight = 1;
+    std::deque<Request> queue;          // Front entries are in flight, the rest wait
+    std::vector<uint8_t> rx;
+    int64_t latency_us = 0;
+    Stats counters;
+    int completed = 0;
+};
+
+// Engine bound to the port opened by init_serial()
+SerialEngine& serial_engine();
@@ -1,4 +1,5 @@
 ﻿#include "serial_sensor.h"
+#include "serial_engine.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,14 +10,81 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <stdbool.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
 #endif
+#endif
+
+#include <vector>
 
 #ifndef _WIN32
 
+// Deadline for a single poll2 response, counted from the end of the request write
+#define POLL2_TIMEOUT_MS 500
+
 static int serial_fd = -1;
+static SerialEngine engine;
+
+SerialEngine& serial_engine() {
+    return engine;
+}
+
+serial_config_t serial_default_config(int baudrate) {
+    serial_config_t config;
+    config.baudrate = baudrate;
+    config.vmin = 0;            // Reads return immediately, waiting is done with poll()
+    config.vtime = 0;
+    config.low_latency = true;
+    return config;
+}
+
+static speed_t baud_to_speed(int baudrate) {
+    switch (baudrate) {
+    case 1200:   return B1200;
+    case 2400:   return B2400;
+    case 4800:   return B4800;
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default:     return 0;
+    }
+}
+
+// Asks the UART driver to push received bytes to the tty layer without batching
+static void set_low_latency(int fd, bool enable) {
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) != 0) return;   // Not every driver (e.g. pty) supports it
+    if (enable) ss.flags |= ASYNC_LOW_LATENCY;
+    else        ss.flags &= ~ASYNC_LOW_LATENCY;
+    ioctl(fd, TIOCSSERIAL, &ss);
+#endif
+}
 
 bool init_serial(const char* device, int baudrate) {
-    serial_fd = open(device, O_RDWR | O_NOCTTY | O_SYNC);
+    serial_config_t config = serial_default_config(baudrate);
+    return init_serial_config(device, &config);
+}
+
+bool init_serial_config(const char* device, const serial_config_t* config) {
+    speed_t speed = baud_to_speed(config->baudrate);
+    if (speed == 0) {
+        fprintf(stderr, "Unsupported baud rate: %d\n", config->baudrate);
+        return false;
+    }
+
+    close_serial();
+    serial_fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
     if (serial_fd < 0) {
         perror("Failed to open serial port");
         return false;
@@ -30,14 +98,14 @@ bool init_serial(const char* device, int baudrate) {
         return false;
     }
 
-    cfsetospeed(&tty, B19200);
-    cfsetispeed(&tty, B19200);
+    cfsetospeed(&tty, speed);
+    cfsetispeed(&tty, speed);
     tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
-    tty.c_iflag &= ~IGNBRK;
+    tty.c_iflag &= ~(IGNBRK | BRKINT | ICRNL | INLCR | PARMRK | ISTRIP);
     tty.c_lflag = 0;
     tty.c_oflag = 0;
-    tty.c_cc[VMIN] = 0;
-    tty.c_cc[VTIME] = 10;
+    tty.c_cc[VMIN] = config->vmin;
+    tty.c_cc[VTIME] = config->vtime;
     tty.c_iflag &= ~(IXON | IXOFF | IXANY);
     tty.c_cflag |= (CLOCAL | CREAD);
     tty.c_cflag &= ~(PARENB | PARODD);
@@ -51,10 +119,14 @@ bool init_serial(const char* device, int baudrate) {
         return false;
     }
 
+    set_low_latency(serial_fd, config->low_latency);
+    tcflush(serial_fd, TCIOFLUSH);
+    engine.attach(serial_fd);
     return true;
 }
 
 void close_serial() {
+    engine.detach();
     if (serial_fd >= 0) {
         close(serial_fd);
         serial_fd = -1;
@@ -62,29 +134,18 @@ void close_serial() {
 }
 
 sensor_data_t getpoll2() {
-    const char* command = "xxxx"; // You should replace this with the actual command to send to your sensor
-    write(serial_fd, command, strlen(command));
-    sleep(1);
-
-    char buffer[256];
-    memset(buffer, 0, sizeof(buffer));
-    int n = read(serial_fd, buffer, sizeof(buffer) - 1);
-
     sensor_data_t data = { 0 };
 
-    if (n <= 0) {
-        fprintf(stderr, "Failed to read data! read() result: %d\n", n);
-        return data;
-    }
-
-    buffer[n] = '\0';
+    char command[32];
+    int len = format_poll2_request(1, command, sizeof(command));
 
-    int count = sscanf(buffer, "%f %f %f", &data.value1, &data.value2, &data.value3);
-    if (count != 3) {
-        fprintf(stderr, "sscanf failed! Parsed float count: %d\n", count);
+    std::vector<uint8_t> response;
+    if (!engine.transact(command, len, POLL2_TIMEOUT_MS, response)) {
+        fprintf(stderr, "Failed to read data! No response within %d ms\n", POLL2_TIMEOUT_MS);
         return data;
     }
 
+    parse_poll2_response(response.data(), response.size(), &data);
     return data;
 }
 
@@ -94,11 +155,36 @@ sensor_data_t getpoll2() {
 // Shared section for both Windows and Linux
 // ------------------
 
-sensor_data_t simulatepoll2() {
-    sensor_data_t d;
-    srand(time(nullptr));
-    d.value1 = 19.0f + ((rand() % 1000) / 1000.0f);
-    d.value2 = 30.5f + ((rand() % 500) / 1000.0f);
-    d.value3 = -0.000010f + ((rand() % 20 - 10) / 1000000.0f);
-    return d;
+int format_poll2_request(int address, char* buf, size_t size) {
+    // You should replace this with the actual command to send to your sensor
+    return snprintf(buf, size, "%d poll2\r\n", address);
+}
+
+bool parse_poll2_response(const uint8_t* frame, size_t len, sensor_data_t* out) {
+    char buffer[256];
+    if (len >= sizeof(buffer)) len = sizeof(buffer) - 1;
+    memcpy(buffer, frame, len);
+    buffer[len] = '\0';
+
+    // Skip the "<address>:" prefix of an addressed answer
+    const char* values = buffer;
+    if (poll2_response_address(frame, len) >= 0) values = strchr(buffer, ':') + 1;
+
+    sensor_data_t data = { 0 };
+    int count = sscanf(values, "%f %f %f", &data.value1, &data.value2, &data.value3);
+    if (count != 3) {
+        fprintf(stderr, "sscanf failed! Parsed float count: %d\n", count);
+        return false;
+    }
+
+    *out = data;
+    return true;
+}
+
+int poll2_response_address(const uint8_t* frame, size_t len) {
+    size_t i = 0;
+    int address = 0;
+    while (i < len && i < 4 && frame[i] >= '0' && frame[i] <= '9')
+        address = address * 10 + (frame[i++] - '0');
+    return (i > 0 && i < len && frame[i] == ':') ? address : -1;
 }
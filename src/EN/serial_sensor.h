@@ -2,6 +2,8 @@
 #define SERIAL_SENSOR_H
 
 #include <stdbool.h>  // ✅ bool için gerekli
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,15 +20,30 @@ extern "C" {
         int line_count;
     } poll3_result_t;
 
+    // Line settings applied by init_serial_config()
+    typedef struct {
+        int  baudrate;          // 1200 ... 921600
+        int  vmin;              // termios VMIN
+        int  vtime;             // termios VTIME, in 0.1 s units (0 = no read timer)
+        bool low_latency;       // Request ASYNC_LOW_LATENCY from the UART driver
+    } serial_config_t;
+
+    serial_config_t serial_default_config(int baudrate);
+
     bool init_serial(const char* device, int baudrate);  // ✅ Değiştirildi
+    bool init_serial_config(const char* device, const serial_config_t* config);
     void close_serial();
     sensor_data_t getpoll2();
     poll3_result_t getpoll3();
     char* getpoll1();
     void free_poll3_result(poll3_result_t* result);
 
+    // poll2 framing for an addressed sensor on the bus
+    int format_poll2_request(int address, char* buf, size_t size);
+    bool parse_poll2_response(const uint8_t* frame, size_t len, sensor_data_t* out);
+    int poll2_response_address(const uint8_t* frame, size_t len);     // -1 without an "<address>:" prefix
+
     char* simulatepoll1();
-    sensor_data_t simulatepoll2();
     poll3_result_t simulatepoll3();
 
 #ifdef __cplusplus
@@ -4,6 +4,7 @@
 #include "screen_manager.h"
 #include "header.h"
 #include "systemfunctions.h"
+#include "sample_clock.h"
 
 #ifndef _WIN32
 #   include <fstream>
@@ -112,6 +113,7 @@ static void apply_datetime(const char* date_str, const char* time_str)
         show_info_popup("Failed to set system time!");
     }
     else {
+        sample_clock_refresh();
         show_info_popup("System time set successfully.");
     }
 }
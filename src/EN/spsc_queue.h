@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// Bounded single-producer / single-consumer queue. Neither side locks or waits:
+// try_push() fails when the queue is full and try_pop() when it is empty.
+// Head and tail live on separate cache lines so the two threads do not share one.
+template <typename T>
+class SpscQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue needs a trivially copyable type");
+
+public:
+    explicit SpscQueue(size_t capacity_pow2)
+        : mask(capacity_pow2 - 1), slots(new T[capacity_pow2]) {}
+
+    bool try_push(const T& value) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) return false;
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+    size_t size() const {
+        return static_cast<size_t>(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+    }
+
+private:
+    size_t mask;
+    std::unique_ptr<T[]> slots;
+
+    alignas(64) std::atomic<uint64_t> head{ 0 };     // Next slot to pop, written by the consumer
+    alignas(64) std::atomic<uint64_t> tail{ 0 };     // Next slot to push, written by the producer
+};
@@ -1,6 +1,7 @@
 ﻿#include "systemfunctions.h"
 #include "lvgl/lvgl.h"
 #include "header.h"
+#include "sample_clock.h"
 
 #include <map>
 #include <fstream>
@@ -97,6 +98,7 @@ bool sync_time_from_api(const std::string& timezone)
         return false;
     }
 
+    sample_clock_refresh();
     log_message("Time sync SUCCESSFUL!");
     return true;
 }
@@ -0,0 +1,140 @@
+﻿#include "text_format.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+// Powers of ten that are exact in a double
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const uint64_t DIGIT_LIMIT[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static double pow10_of(int k) {
+    return k <= 22 ? POW10[k] : POW10[22] * pow10_of(k - 22);
+}
+
+// a * 10^k, rounded once for |k| <= 22
+static double scale10(double a, int k) {
+    return k >= 0 ? a * pow10_of(k) : a / pow10_of(-k);
+}
+
+static char* put_digits(char* p, uint64_t v, int n) {
+    for (int i = n - 1; i >= 0; --i) {
+        p[i] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    }
+    return p + n;
+}
+
+size_t format_float(float value, char* out) {
+    char* p = out;
+    if (signbit(value)) *p++ = '-';
+    double a = fabs(static_cast<double>(value));
+    if (a == 0.0) {
+        *p++ = '0';
+        return static_cast<size_t>(p - out);
+    }
+
+    // Decimal exponent: log10(2^b) estimate from the binary exponent, at most one too low
+    int b;
+    frexp(a, &b);
+    int e = ((b - 1) * 78913) >> 18;
+    if (a >= scale10(1.0, e + 1)) ++e;
+
+    // Fewest digits that round-trip; 9 always does for a float
+    float target = fabsf(value);
+    uint64_t digits = 0;
+    int n = 6;
+    int first = e;
+    for (; n <= 9; ++n) {
+        digits = static_cast<uint64_t>(llround(scale10(a, n - 1 - e)));
+        first = e;
+        if (digits >= DIGIT_LIMIT[n]) {         // Rounded up to the next power of ten
+            digits /= 10;
+            ++first;
+        }
+        if (n == 9 || static_cast<float>(scale10(static_cast<double>(digits), first - n + 1)) == target) break;
+    }
+    e = first;
+    while (n > 1 && digits % 10 == 0) {
+        digits /= 10;
+        --n;
+    }
+
+    char text[9];
+    put_digits(text, digits, n);
+
+    if (e < -4 || e > 8) {
+        *p++ = text[0];
+        if (n > 1) {
+            *p++ = '.';
+            memcpy(p, text + 1, n - 1);
+            p += n - 1;
+        }
+        *p++ = 'e';
+        *p++ = e < 0 ? '-' : '+';
+        int x = e < 0 ? -e : e;
+        p = put_digits(p, static_cast<uint64_t>(x), 2);       // A float exponent has at most two digits
+    }
+    else if (e >= 0) {
+        int whole = e + 1;
+        if (n <= whole) {
+            memcpy(p, text, n);
+            memset(p + n, '0', whole - n);
+            p += whole;
+        }
+        else {
+            memcpy(p, text, whole);
+            p += whole;
+            *p++ = '.';
+            memcpy(p, text + whole, n - whole);
+            p += n - whole;
+        }
+    }
+    else {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -e - 1);
+        p += -e - 1;
+        memcpy(p, text, n);
+        p += n;
+    }
+    return static_cast<size_t>(p - out);
+}
+
+size_t TimestampFormatter::format(int64_t realtime_ns, char* out) {
+    int64_t sec = realtime_ns / 1000000000;
+    if (realtime_ns < 0 && realtime_ns % 1000000000) --sec;
+
+    if (sec != cached_sec) {
+        time_t t = static_cast<time_t>(sec);
+        struct tm tm_local;
+#ifdef _WIN32
+        localtime_s(&tm_local, &t);
+#else
+        localtime_r(&t, &tm_local);
+#endif
+        char* p = put_digits(prefix, static_cast<uint64_t>(tm_local.tm_year + 1900), 4);
+        *p++ = '-';
+        p = put_digits(p, static_cast<uint64_t>(tm_local.tm_mon + 1), 2);
+        *p++ = '-';
+        p = put_digits(p, static_cast<uint64_t>(tm_local.tm_mday), 2);
+        *p++ = sep;
+        p = put_digits(p, static_cast<uint64_t>(tm_local.tm_hour), 2);
+        *p++ = ':';
+        p = put_digits(p, static_cast<uint64_t>(tm_local.tm_min), 2);
+        *p++ = ':';
+        put_digits(p, static_cast<uint64_t>(tm_local.tm_sec), 2);
+        cached_sec = sec;
+    }
+
+    memcpy(out, prefix, 19);
+    out[19] = '.';
+    put_digits(out + 20, static_cast<uint64_t>((realtime_ns - sec * 1000000000) / 1000000), 3);
+    return TEXT_TIME_LEN;
+}
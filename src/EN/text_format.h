@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Allocation-free text formatting for the export path. Both functions write into the
+// caller's buffer without a terminating '\0' and return the number of bytes written.
+
+#define TEXT_FLOAT_MAX 16       // Longest format_float() output, "-1.17549435e-38"
+#define TEXT_TIME_LEN  23       // "2025-06-24 16:33:19.123"
+
+// Finite float as the fewest of 6..9 significant digits that read back as the same
+// value: "19.559", "-2e-06". Plain notation unless the exponent is below -4 or above 8,
+// like printf("%g"). Callers handle NaN and infinity.
+size_t format_float(float value, char* out);
+
+// Local wall-clock time with milliseconds. The date and time of day are only
+// recomputed when the second changes, so consecutive samples cost a copy and three digits.
+class TimestampFormatter {
+public:
+    explicit TimestampFormatter(char separator = ' ') : sep(separator) {}
+
+    size_t format(int64_t realtime_ns, char* out);
+
+private:
+    int64_t cached_sec = INT64_MIN;
+    char prefix[20] = {};       // "YYYY-mm-dd HH:MM:SS"
+    char sep;
+};